@@ -0,0 +1,38 @@
+/**
+ * In-process benchmark of IPC/shared-memory-ringbuffer-atomic, lock-free SPSC RingBuffer over HeapRing, between a
+ * producer and a consumer thread, see inproc.h.
+ *
+ * '--size element' sends ElementData, the element writer and reader exchange.
+ *
+ * Usage: ./bench-inproc-atomic [--count N] [--rounds N] [--capacity 2^n] [--size 16|64|256|1024|4096|element]
+ * [--placement none|same-cpu|smt|core|socket] [--header]
+ */
+#include "inproc.h"
+
+#include "../shared-memory-ringbuffer-atomic/heapring.h"
+
+using namespace inproc;
+
+namespace
+{
+
+template <typename T>
+int runType(const Options& opts)
+{
+	HeapRing<T> rings[2] = { HeapRing<T>(opts.capacity), HeapRing<T>(opts.capacity) };
+
+	return run<T>("shared-memory-ringbuffer-atomic", opts, [&](int idx, auto&& f) {
+		auto rb = rings[idx].ring();
+		f(rb);
+	});
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+	const Options opts = parseOptions(argc, argv);
+	if (opts.element)
+		return runType<ElementData>(opts);
+	return harness::withSize(opts.size, [&](auto size) { return runType<Message<decltype(size)::value>>(opts); });
+}
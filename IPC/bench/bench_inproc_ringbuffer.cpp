@@ -0,0 +1,101 @@
+/**
+ * In-process benchmark of IPC/shared-memory-ringbuffer, RingBuffer of ElementData guarded by pthread_rwlock_t, or by
+ * the ticket or MCS lock when built with -DUSE_TICKET_LOCK or -DUSE_MCS_LOCK (see locks.h), between a producer and a
+ * consumer thread, see inproc.h.
+ *
+ * Control fields and elements are laid out as in SharedData, but from std::aligned_alloc(). Elements are always
+ * ElementData, so '--size' is ignored and the row shows sizeof(ElementData).
+ *
+ * Usage: ./bench-inproc-ringbuffer[-ticket|-mcs] [--count N] [--rounds N] [--capacity 2^n]
+ * [--placement none|same-cpu|smt|core|socket] [--header]
+ */
+#include "inproc.h"
+
+#include "../shared-memory-ringbuffer/ringbuffer.h"
+
+using namespace inproc;
+
+namespace
+{
+
+// one row per lock the ring is built with
+#if defined(USE_TICKET_LOCK)
+const char* const sVariant = "shared-memory-ringbuffer-ticket";
+#elif defined(USE_MCS_LOCK)
+const char* const sVariant = "shared-memory-ringbuffer-mcs";
+#else
+const char* const sVariant = "shared-memory-ringbuffer";
+#endif
+
+// RingBuffer::put() waits on its own while ring is full, as inproc.h wants to do the waiting
+struct Ring
+{
+	RingBuffer& rb;
+
+	// only producer puts, so ring can't become full between the two calls
+	bool tryPut(const ElementData& obj)
+	{
+		if (rb.isFull())
+			return false;
+		rb.put(obj);
+		return true;
+	}
+
+	bool get(ElementData& rdata)
+	{
+		return rb.get(rdata);
+	}
+};
+
+// RingBufferCtrlFields followed by elements, on the heap
+class HeapRing
+{
+public:
+	explicit HeapRing(std::size_t capacity) :
+		m_capacity(capacity)
+	{
+		const std::size_t size = sizeof(RingBufferCtrlFields) + (capacity * sizeof(ElementData) + 63) / 64 * 64;
+		void* ptr = std::aligned_alloc(alignof(RingBufferCtrlFields), size);
+		if (ptr == nullptr)
+			throw std::runtime_error("Error: HeapRing can't allocate the ring");
+
+		m_ctrl = new (ptr) RingBufferCtrlFields();
+		m_elems = reinterpret_cast<ElementData*>(m_ctrl + 1);
+		initRingLock(&m_ctrl->lock);
+	}
+
+	~HeapRing()
+	{
+		destroyRingLock(&m_ctrl->lock);
+		std::free(m_ctrl);
+	}
+
+	RingBuffer ring()
+	{
+		return RingBuffer(m_elems, static_cast<int>(m_capacity), &m_ctrl->lock, &m_ctrl->head, &m_ctrl->tail);
+	}
+
+private:
+	// disable copy-construct, and assignment operator
+	HeapRing(const HeapRing&);
+	HeapRing& operator=(const HeapRing&);
+
+	std::size_t m_capacity = 0;
+	RingBufferCtrlFields* m_ctrl = nullptr;
+	ElementData* m_elems = nullptr;
+};
+
+}
+
+int main(int argc, char* argv[])
+{
+	const Options opts = parseOptions(argc, argv);
+
+	HeapRing rings[2] = { HeapRing(opts.capacity), HeapRing(opts.capacity) };
+
+	return run<ElementData>(sVariant, opts, [&](int idx, auto&& f) {
+		RingBuffer rb = rings[idx].ring();
+		Ring ring{rb};
+		f(ring);
+	});
+}
@@ -0,0 +1,102 @@
+/**
+ * Benchmark of IPC/shared-memory-pthread-locking, a single slot guarded by a process-shared pthread_rwlock_t.
+ *
+ * Writer takes the write lock for every message, readers take the read lock to copy the slot out. As with the
+ * unsynchronized slot, writer doesn't wait for readers to see a message, so 'delivered' is the share of messages each
+ * reader got to see.
+ *
+ * Usage: ./bench-pthread-locking [--count N] [--size N] [--readers N] [--header]
+ */
+#include "harness.h"
+
+#include <pthread.h>
+
+using namespace harness;
+
+namespace
+{
+
+template <std::size_t Size>
+struct Slot
+{
+	pthread_rwlock_t rwlock;
+	Message<Size> msg;
+};
+
+struct alignas(64) Shared
+{
+	Control ctrl;
+};
+
+template <std::size_t Size>
+int runSize(const Options& opts)
+{
+	Shared* shared = bench::mapShared<Shared>();
+	Slot<Size>* slot = bench::mapShared<Slot<Size>>();
+
+	// initialized once before fork, as writer does it before readers attach
+	pthread_rwlockattr_t attr;
+	pthread_rwlockattr_init(&attr);
+	pthread_rwlockattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+	pthread_rwlock_init(&slot->rwlock, &attr);
+	pthread_rwlockattr_destroy(&attr);
+
+	auto writer = [&]() {
+		writerStart(&shared->ctrl, opts.readers);
+
+		Message<Size> msg;
+		std::memset(&msg, 'x', sizeof(msg));
+		for (std::uint64_t seq=1; seq<=opts.count; ++seq)
+		{
+			msg.seq = seq;
+			msg.sent_ns = bench::nowNs();
+
+			pthread_rwlock_wrlock(&slot->rwlock);
+			slot->msg = msg;
+			pthread_rwlock_unlock(&slot->rwlock);
+		}
+
+		writerDone(&shared->ctrl);
+	};
+
+	auto reader = [&](int, ReaderResult& result) {
+		readerReady(&shared->ctrl);
+
+		Message<Size> msg;
+		std::uint64_t last_seq = 0;
+		while (true)
+		{
+			const bool done = shared->ctrl.done.load(std::memory_order_acquire);
+
+			pthread_rwlock_rdlock(&slot->rwlock);
+			msg = slot->msg;
+			pthread_rwlock_unlock(&slot->rwlock);
+
+			if (msg.seq != last_seq)
+			{
+				result.histogram.record(bench::nowNs() - msg.sent_ns);
+				++result.received;
+				last_seq = msg.seq;
+			}
+			else if (done)
+				break;
+			else
+				sched_yield();
+		}
+	};
+
+	const int res = run("shared-memory-pthread-locking", opts, Size, Delivery::Fanout, &shared->ctrl, writer, reader);
+
+	pthread_rwlock_destroy(&slot->rwlock);
+	bench::unmapShared(slot);
+	bench::unmapShared(shared);
+	return res;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+	const Options opts = parseOptions(argc, argv);
+	return withSize(opts.size, [&](auto size) { return runSize<decltype(size)::value>(opts); });
+}
@@ -0,0 +1,95 @@
+/**
+ * Benchmark of IPC/shared-memory-ringbuffer, RingBuffer of ElementData guarded by a process-shared pthread_rwlock_t,
+ * or by the ticket or MCS lock when built with -DUSE_TICKET_LOCK or -DUSE_MCS_LOCK (see locks.h).
+ *
+ * Elements are always ElementData, so '--size' is ignored and the row shows sizeof(ElementData). Writer blocks while
+ * the ring is full, so every message reaches the reader.
+ * RingBuffer::get() checks isEmpty() and takes the element in two lock sections, so it only supports one reader.
+ *
+ * Usage: ./bench-ringbuffer[-ticket|-mcs] [--count N] [--readers 1] [--header]
+ */
+#include "harness.h"
+
+#include "../shared-memory-ringbuffer/ringbuffer.h"
+
+using namespace harness;
+
+namespace
+{
+
+// one row per lock the ring is built with
+#if defined(USE_TICKET_LOCK)
+const char* const sVariant = "shared-memory-ringbuffer-ticket";
+#elif defined(USE_MCS_LOCK)
+const char* const sVariant = "shared-memory-ringbuffer-mcs";
+#else
+const char* const sVariant = "shared-memory-ringbuffer";
+#endif
+
+struct alignas(64) Shared
+{
+	Control ctrl;
+	SharedData data;
+};
+
+}
+
+int main(int argc, char* argv[])
+{
+	const Options opts = parseOptions(argc, argv);
+	const char* variant = sVariant;
+
+	if (opts.readers != 1)
+	{
+		printUnsupported(variant, opts, sizeof(ElementData), "single consumer only");
+		return 0;
+	}
+
+	Shared* shared = bench::mapShared<Shared>();
+
+	// initialized once before fork, as writer does it before readers attach
+	initRingLock(&shared->data.rb_ctrl_fields.lock);
+
+	auto writer = [&]() {
+		RingBuffer rb(shared->data.elems, sElementSize, &shared->data.rb_ctrl_fields.lock, &shared->data.rb_ctrl_fields.head, &shared->data.rb_ctrl_fields.tail);
+		writerStart(&shared->ctrl, opts.readers);
+
+		ElementData elem_data;
+		std::strcpy(elem_data.name, "hello world");
+		for (std::uint64_t seq=1; seq<=opts.count; ++seq)
+		{
+			elem_data.id = static_cast<int>(seq);
+			elem_data.sent_ns = bench::nowNs();
+			rb.put(elem_data);
+		}
+
+		writerDone(&shared->ctrl);
+	};
+
+	auto reader = [&](int, ReaderResult& result) {
+		RingBuffer rb(shared->data.elems, sElementSize, &shared->data.rb_ctrl_fields.lock, &shared->data.rb_ctrl_fields.head, &shared->data.rb_ctrl_fields.tail);
+		readerReady(&shared->ctrl);
+
+		ElementData elem_data;
+		while (true)
+		{
+			const bool done = shared->ctrl.done.load(std::memory_order_acquire);
+
+			if (rb.get(elem_data))
+			{
+				result.histogram.record(bench::nowNs() - elem_data.sent_ns);
+				++result.received;
+			}
+			else if (done)
+				break;
+			else
+				sched_yield();
+		}
+	};
+
+	const int res = run(variant, opts, sizeof(ElementData), Delivery::Shared, &shared->ctrl, writer, reader);
+
+	destroyRingLock(&shared->data.rb_ctrl_fields.lock);
+	bench::unmapShared(shared);
+	return res;
+}
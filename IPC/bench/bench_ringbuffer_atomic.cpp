@@ -0,0 +1,110 @@
+/**
+ * Benchmark of IPC/shared-memory-ringbuffer-atomic.
+ *
+ * With one reader it's the lock-free SPSC RingBuffer (with cached indices), with more readers it's MPMCRingBuffer
+ * as RingBuffer is single-consumer. Writer waits while the ring is full, so every message reaches a reader, and
+ * readers share the messages between them.
+ *
+ * Usage: ./bench-ringbuffer-atomic [--count N] [--size N] [--readers N] [--header]
+ */
+#include "harness.h"
+
+#include "../shared-memory-ringbuffer-atomic/ringbuffer.h"
+#include "../shared-memory-ringbuffer-atomic/mpmc_ringbuffer.h"
+
+using namespace harness;
+
+namespace
+{
+
+template <std::size_t Size>
+struct Shared
+{
+	Control ctrl;
+
+	alignas(64) std::atomic<std::uint64_t> head;
+	alignas(64) std::atomic<std::uint64_t> tail;
+	alignas(64) Message<Size> elems[sElementSize];
+
+	MPMCCtrlFields mpmc_ctrl_fields;
+	MPMCSlot<Message<Size>> mpmc_elems[sElementSize];
+};
+
+// Pick the ring for the number of readers, and pass it to f
+template <std::size_t Size, typename F>
+void withRing(Shared<Size>* shared, int readers, F&& f)
+{
+	if (readers == 1)
+	{
+		BasicRingBuffer<Message<Size>, sElementSize> rb(shared->elems, &shared->head, &shared->tail);
+		f(rb);
+	}
+	else
+	{
+		MPMCRingBuffer<Message<Size>, sElementSize> rb(shared->mpmc_elems, &shared->mpmc_ctrl_fields);
+		f(rb);
+	}
+}
+
+template <std::size_t Size>
+int runSize(const Options& opts)
+{
+	Shared<Size>* shared = bench::mapShared<Shared<Size>>();
+
+	// initialized once before fork, as writer does it before readers attach
+	MPMCRingBuffer<Message<Size>, sElementSize> mpmc(shared->mpmc_elems, &shared->mpmc_ctrl_fields);
+	mpmc.init();
+
+	auto writer = [&]() {
+		withRing(shared, opts.readers, [&](auto& rb) {
+			writerStart(&shared->ctrl, opts.readers);
+
+			Message<Size> msg;
+			std::memset(&msg, 'x', sizeof(msg));
+			for (std::uint64_t seq=1; seq<=opts.count; ++seq)
+			{
+				msg.seq = seq;
+				msg.sent_ns = bench::nowNs();
+				while (!rb.tryPut(msg))
+					sched_yield();
+			}
+
+			writerDone(&shared->ctrl);
+		});
+	};
+
+	auto reader = [&](int, ReaderResult& result) {
+		withRing(shared, opts.readers, [&](auto& rb) {
+			readerReady(&shared->ctrl);
+
+			Message<Size> msg;
+			while (true)
+			{
+				const bool done = shared->ctrl.done.load(std::memory_order_acquire);
+
+				if (rb.get(msg))
+				{
+					result.histogram.record(bench::nowNs() - msg.sent_ns);
+					++result.received;
+				}
+				else if (done)
+					break;
+				else
+					sched_yield();
+			}
+		});
+	};
+
+	const int res = run("shared-memory-ringbuffer-atomic", opts, Size, Delivery::Shared, &shared->ctrl, writer, reader);
+
+	bench::unmapShared(shared);
+	return res;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+	const Options opts = parseOptions(argc, argv);
+	return withSize(opts.size, [&](auto size) { return runSize<decltype(size)::value>(opts); });
+}
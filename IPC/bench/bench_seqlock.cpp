@@ -0,0 +1,80 @@
+/**
+ * Benchmark of the seqlock build of IPC/shared-memory-pthread-locking, a single slot in SeqLocked.
+ *
+ * Same load as bench-pthread-locking, so the two compare directly: writer never waits for readers, and readers copy
+ * the slot optimistically retrying when writer was in the middle of an update. 'delivered' is the share of
+ * messages each reader got to see.
+ *
+ * Usage: ./bench-seqlock [--count N] [--size N] [--readers N] [--header]
+ */
+#include "harness.h"
+
+#include "../shared-memory-pthread-locking/seqlock.h"
+
+using namespace harness;
+
+namespace
+{
+
+struct alignas(64) Shared
+{
+	Control ctrl;
+};
+
+template <std::size_t Size>
+int runSize(const Options& opts)
+{
+	Shared* shared = bench::mapShared<Shared>();
+	lib::SeqLocked<Message<Size>>* slot = bench::mapShared<lib::SeqLocked<Message<Size>>>();
+
+	auto writer = [&]() {
+		writerStart(&shared->ctrl, opts.readers);
+
+		Message<Size> msg;
+		std::memset(&msg, 'x', sizeof(msg));
+		for (std::uint64_t seq=1; seq<=opts.count; ++seq)
+		{
+			msg.seq = seq;
+			msg.sent_ns = bench::nowNs();
+			slot->store(msg);
+		}
+
+		writerDone(&shared->ctrl);
+	};
+
+	auto reader = [&](int, ReaderResult& result) {
+		readerReady(&shared->ctrl);
+
+		Message<Size> msg;
+		std::uint64_t last_seq = 0;
+		while (true)
+		{
+			const bool done = shared->ctrl.done.load(std::memory_order_acquire);
+
+			if (slot->tryLoad(msg) && msg.seq != last_seq)
+			{
+				result.histogram.record(bench::nowNs() - msg.sent_ns);
+				++result.received;
+				last_seq = msg.seq;
+			}
+			else if (done)
+				break;
+			else
+				sched_yield();
+		}
+	};
+
+	const int res = run("shared-memory-seqlock", opts, Size, Delivery::Fanout, &shared->ctrl, writer, reader);
+
+	bench::unmapShared(slot);
+	bench::unmapShared(shared);
+	return res;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+	const Options opts = parseOptions(argc, argv);
+	return withSize(opts.size, [&](auto size) { return runSize<decltype(size)::value>(opts); });
+}
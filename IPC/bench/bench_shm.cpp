@@ -0,0 +1,101 @@
+/**
+ * Benchmark of IPC/shared-memory, a single slot written and read without any synchronization.
+ *
+ * Writer overwrites the slot as fast as it can and never waits for readers, so readers only see the latest message
+ * at the time they look, and 'delivered' is the share of messages each reader got to see. A message is copied out
+ * and only counted if the sequence at its both ends agree, otherwise writer was in the middle of overwriting it.
+ *
+ * Usage: ./bench-shm [--count N] [--size N] [--readers N] [--header]
+ */
+#include "harness.h"
+
+using namespace harness;
+
+namespace
+{
+
+template <std::size_t Size>
+struct Slot
+{
+	Message<Size> msg;
+	// copy of msg.seq written last, to spot torn reads
+	std::uint64_t seq_end;
+};
+
+struct alignas(64) Shared
+{
+	Control ctrl;
+};
+
+// nothing is atomic in this variant, this only stops compiler from caching the slot in registers
+inline void compilerBarrier()
+{
+	asm volatile("" ::: "memory");
+}
+
+template <std::size_t Size>
+int runSize(const Options& opts)
+{
+	Shared* shared = bench::mapShared<Shared>();
+	Slot<Size>* slot = bench::mapShared<Slot<Size>>();
+
+	auto writer = [&]() {
+		writerStart(&shared->ctrl, opts.readers);
+
+		Message<Size> msg;
+		std::memset(&msg, 'x', sizeof(msg));
+		for (std::uint64_t seq=1; seq<=opts.count; ++seq)
+		{
+			msg.seq = seq;
+			msg.sent_ns = bench::nowNs();
+			std::memcpy(&slot->msg, &msg, sizeof(msg));
+			compilerBarrier();
+			slot->seq_end = seq;
+			compilerBarrier();
+		}
+
+		writerDone(&shared->ctrl);
+	};
+
+	auto reader = [&](int, ReaderResult& result) {
+		readerReady(&shared->ctrl);
+
+		Message<Size> msg;
+		std::uint64_t last_seq = 0;
+		while (true)
+		{
+			const bool done = shared->ctrl.done.load(std::memory_order_acquire);
+
+			compilerBarrier();
+			const std::uint64_t seq_end = slot->seq_end;
+			compilerBarrier();
+			std::memcpy(&msg, &slot->msg, sizeof(msg));
+			compilerBarrier();
+
+			if (msg.seq != last_seq && msg.seq == seq_end)
+			{
+				result.histogram.record(bench::nowNs() - msg.sent_ns);
+				++result.received;
+				last_seq = msg.seq;
+			}
+			else if (done)
+				break;
+			else
+				sched_yield();
+		}
+	};
+
+	const int res = run("shared-memory", opts, Size, Delivery::Fanout, &shared->ctrl, writer, reader);
+
+	bench::unmapShared(slot);
+	bench::unmapShared(shared);
+	return res;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+	const Options opts = parseOptions(argc, argv);
+	return withSize(opts.size, [&](auto size) { return runSize<decltype(size)::value>(opts); });
+}
@@ -0,0 +1,312 @@
+#pragma once
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <iterator>
+#include <string>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "../shared-memory-ringbuffer-atomic/bench.h"
+#include "../shared-memory-ringbuffer-atomic/histogram.h"
+#include "../shared-memory-ringbuffer-atomic/affinity.h"
+
+// Common driver of bench_*.cpp, one binary per IPC variant as each variant has its own lib.h.
+//
+// Writer and readers are forked processes talking through an anonymous shared mapping, the same kind of pages
+// shm_open() gives writer and reader, and nothing sleeps. Every message carries its sequence and the time it was
+// sent, so readers measure one-way latency. Each binary prints one row of the comparison table.
+namespace harness
+{
+
+const int sMaxReaders = 16;
+
+// Where writer and readers run relative to each other. All readers share one CPU.
+enum class Placement
+{
+	// wherever scheduler puts them
+	None,
+	// writer and readers on the same CPU
+	SameCpu,
+	// hyperthread siblings of one physical core
+	Smt,
+	// different physical cores of one socket
+	Core,
+	// different sockets
+	Socket
+};
+
+const char* const sPlacementNames[] = {"none", "same-cpu", "smt", "core", "socket"};
+
+struct Options
+{
+	std::uint64_t count = 1'000'000;
+	std::size_t size = 64;
+	int readers = 1;
+	bool header = false;
+	Placement placement = Placement::None;
+};
+
+inline Options parseOptions(int argc, char* argv[])
+{
+	Options opts;
+	for (int i=1; i<argc; ++i)
+	{
+		const std::string_view arg(argv[i]);
+		if (arg == "--header")
+			opts.header = true;
+		else if (arg == "--count" && i + 1 < argc)
+			opts.count = std::strtoull(argv[++i], nullptr, 10);
+		else if (arg == "--size" && i + 1 < argc)
+			opts.size = std::strtoull(argv[++i], nullptr, 10);
+		else if (arg == "--readers" && i + 1 < argc)
+			opts.readers = std::atoi(argv[++i]);
+		else if (arg == "--placement" && i + 1 < argc)
+		{
+			const std::string_view name(argv[++i]);
+			auto it = std::find(std::begin(sPlacementNames), std::end(sPlacementNames), name);
+			if (it == std::end(sPlacementNames))
+			{
+				std::cerr << "Error: unknown placement " << name << "\n";
+				std::exit(1);
+			}
+			opts.placement = static_cast<Placement>(it - std::begin(sPlacementNames));
+		}
+		else
+		{
+			std::cerr << "Usage: " << argv[0] << " [--count N] [--size 16|64|256|1024|4096] [--readers 1.." << sMaxReaders << "]"
+				<< " [--placement none|same-cpu|smt|core|socket] [--header]\n";
+			std::exit(1);
+		}
+	}
+
+	if (opts.count == 0 || opts.readers < 1 || opts.readers > sMaxReaders)
+	{
+		std::cerr << "Error: count has to be positive, and readers in 1.." << sMaxReaders << "\n";
+		std::exit(1);
+	}
+	return opts;
+}
+
+// Pick CPUs for writer and readers among those this process may run on. Return false if the machine has no such pair.
+inline bool placementCpus(Placement placement, int& writer_cpu, int& reader_cpu)
+{
+	cpu_set_t allowed;
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+		return false;
+
+	writer_cpu = -1;
+	int writer_package = -1;
+	int writer_core = -1;
+	for (int cpu=0; cpu<CPU_SETSIZE; ++cpu)
+	{
+		if (!CPU_ISSET(cpu, &allowed))
+			continue;
+
+		int package = -1;
+		int core = -1;
+		if (!lib::cpuTopology(cpu, package, core))
+			continue;
+
+		if (writer_cpu == -1)
+		{
+			writer_cpu = cpu;
+			writer_package = package;
+			writer_core = core;
+			if (placement == Placement::SameCpu)
+			{
+				reader_cpu = cpu;
+				return true;
+			}
+			continue;
+		}
+
+		const bool found = (placement == Placement::Smt && package == writer_package && core == writer_core)
+			|| (placement == Placement::Core && package == writer_package && core != writer_core)
+			|| (placement == Placement::Socket && package != writer_package);
+		if (found)
+		{
+			reader_cpu = cpu;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Message of exactly 'Size' bytes, 'seq' starts from 1 so 0 means nothing has been written yet
+template <std::size_t Size>
+struct Message
+{
+	static_assert(Size >= 16, "Message needs room for seq and sent_ns");
+
+	std::uint64_t seq;
+	std::uint64_t sent_ns;
+	char payload[Size - 16];
+};
+
+// Call f(std::integral_constant<std::size_t, N>) for runtime 'size' among supported message sizes
+template <typename F>
+int withSize(std::size_t size, F&& f)
+{
+	switch (size)
+	{
+		case 16: return f(std::integral_constant<std::size_t, 16>{});
+		case 64: return f(std::integral_constant<std::size_t, 64>{});
+		case 256: return f(std::integral_constant<std::size_t, 256>{});
+		case 1024: return f(std::integral_constant<std::size_t, 1024>{});
+		case 4096: return f(std::integral_constant<std::size_t, 4096>{});
+	}
+	std::cerr << "Error: unsupported size " << size << "\n";
+	return 1;
+}
+
+struct ReaderResult
+{
+	alignas(64) std::uint64_t received;
+	lib::LatencyHistogram histogram;
+};
+
+struct Control
+{
+	// readers check in before writer starts, so nobody misses the beginning
+	alignas(64) std::atomic<int> ready;
+	// set by writer after the last message
+	alignas(64) std::atomic<bool> done;
+	alignas(64) std::uint64_t start_ns;
+	ReaderResult results[sMaxReaders];
+};
+
+// Whether every reader is meant to see every message (single slot), or readers share the messages (ring)
+enum class Delivery
+{
+	Fanout,
+	Shared
+};
+
+inline void printHeader()
+{
+	std::cout << std::left << std::setw(32) << "variant"
+		<< std::setw(14) << "placement"
+		<< std::right << std::setw(8) << "readers"
+		<< std::setw(7) << "size"
+		<< std::setw(13) << "msgs/s"
+		<< std::setw(10) << "ns/msg"
+		<< std::setw(12) << "p99 ns"
+		<< std::setw(12) << "cpu ns/msg"
+		<< std::setw(11) << "delivered" << "\n";
+}
+
+// Placement with CPUs it ended up on, ex. "smt 0/4"
+inline std::string placementName(const Options& opts)
+{
+	std::string name = sPlacementNames[static_cast<int>(opts.placement)];
+	int writer_cpu = -1;
+	int reader_cpu = -1;
+	if (opts.placement != Placement::None && placementCpus(opts.placement, writer_cpu, reader_cpu))
+		name += " " + std::to_string(writer_cpu) + "/" + std::to_string(reader_cpu);
+	return name;
+}
+
+// Row for a combination the variant can't run
+inline void printUnsupported(const char* variant, const Options& opts, std::size_t size, const char* reason)
+{
+	if (opts.header)
+		printHeader();
+	std::cout << std::left << std::setw(32) << variant
+		<< std::setw(14) << placementName(opts)
+		<< std::right << std::setw(8) << opts.readers
+		<< std::setw(7) << size
+		<< "  - " << reason << "\n";
+}
+
+// Wait until all readers checked in, then take the start time
+inline void writerStart(Control* ctrl, int readers)
+{
+	while (ctrl->ready.load(std::memory_order_acquire) < readers)
+		sched_yield();
+	ctrl->start_ns = bench::nowNs();
+}
+
+inline void writerDone(Control* ctrl)
+{
+	ctrl->done.store(true, std::memory_order_release);
+}
+
+inline void readerReady(Control* ctrl)
+{
+	ctrl->ready.fetch_add(1, std::memory_order_acq_rel);
+}
+
+// Fork 'opts.readers' processes running reader(idx, ReaderResult&), and one running writer().
+// Wait for all of them and print the row. 'size' is what actually travels per message.
+template <typename W, typename R>
+int run(const char* variant, const Options& opts, std::size_t size, Delivery delivery, Control* ctrl, W&& writer, R&& reader)
+{
+	int writer_cpu = -1;
+	int reader_cpu = -1;
+	if (opts.placement != Placement::None && !placementCpus(opts.placement, writer_cpu, reader_cpu))
+	{
+		printUnsupported(variant, opts, size, "no such pair of CPUs on this machine");
+		return 0;
+	}
+
+	// each child pins itself before doing anything, so it runs and first-touches memory where it's meant to
+	for (int i=0; i<opts.readers; ++i)
+	{
+		bench::spawn([&, i]() {
+			if (reader_cpu != -1 && !lib::pinToCpu(reader_cpu))
+				std::_Exit(1);
+			reader(i, ctrl->results[i]);
+		});
+	}
+	bench::spawn([&]() {
+		if (writer_cpu != -1 && !lib::pinToCpu(writer_cpu))
+			std::_Exit(1);
+		writer();
+	});
+	bench::waitAll();
+
+	const std::uint64_t elapsed_ns = bench::nowNs() - ctrl->start_ns;
+
+	// writer and readers are all children, and have all been waited for
+	rusage usage;
+	getrusage(RUSAGE_CHILDREN, &usage);
+	const double cpu_ns = (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e9 + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e3;
+
+	lib::LatencyHistogram histogram;
+	std::uint64_t received = 0;
+	for (int i=0; i<opts.readers; ++i)
+	{
+		histogram.merge(ctrl->results[i].histogram);
+		received += ctrl->results[i].received;
+	}
+
+	const std::uint64_t expected = delivery == Delivery::Fanout ? opts.count * opts.readers : opts.count;
+
+	if (opts.header)
+		printHeader();
+	std::cout << std::left << std::setw(32) << variant
+		<< std::setw(14) << placementName(opts)
+		<< std::right << std::setw(8) << opts.readers
+		<< std::setw(7) << size
+		<< std::fixed << std::setprecision(0)
+		<< std::setw(13) << opts.count * 1e9 / elapsed_ns
+		<< std::setprecision(1)
+		<< std::setw(10) << static_cast<double>(elapsed_ns) / opts.count
+		<< std::setw(12) << histogram.percentile(99.0)
+		<< std::setw(12) << cpu_ns / opts.count
+		<< std::setprecision(2) << std::setw(10) << 100.0 * received / expected << "%\n";
+
+	return 0;
+}
+
+};
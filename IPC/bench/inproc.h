@@ -0,0 +1,297 @@
+#pragma once
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <iterator>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <cstdint>
+#include <cstdlib>
+#include <string_view>
+
+#include "harness.h"
+
+// Common driver of bench_inproc_*.cpp, one binary per ring implementation as each has its own lib.h.
+//
+// Unlike harness.h, producer and consumer are two threads of one process and the ring lives in heap memory, so
+// what's measured is the ring itself, not processes or shared mappings. Both threads are pinned before they touch
+// the ring. Two measurements per row:
+//
+// * throughput - producer puts 'count' elements as fast as it can, consumer gets them, timed until consumer has the
+// last one
+// * round trip - one element at a time goes over one ring and comes back over another of the same capacity, the time
+// it takes is recorded 'rounds' times. Nothing queues up, so it's the latency of an idle ring.
+namespace inproc
+{
+
+using harness::Placement;
+using harness::sPlacementNames;
+using harness::Message;
+
+struct Options
+{
+	std::uint64_t count = 1'000'000;
+	std::uint64_t rounds = 100'000;
+	std::size_t capacity = 1024;
+	std::size_t size = 64;
+	// ElementData instead of Message<size>
+	bool element = false;
+	bool header = false;
+	Placement placement = Placement::Core;
+};
+
+inline Options parseOptions(int argc, char* argv[])
+{
+	Options opts;
+	for (int i=1; i<argc; ++i)
+	{
+		const std::string_view arg(argv[i]);
+		if (arg == "--header")
+			opts.header = true;
+		else if (arg == "--count" && i + 1 < argc)
+			opts.count = std::strtoull(argv[++i], nullptr, 10);
+		else if (arg == "--rounds" && i + 1 < argc)
+			opts.rounds = std::strtoull(argv[++i], nullptr, 10);
+		else if (arg == "--capacity" && i + 1 < argc)
+			opts.capacity = std::strtoull(argv[++i], nullptr, 10);
+		else if (arg == "--size" && i + 1 < argc)
+		{
+			const std::string_view size(argv[++i]);
+			opts.element = size == "element";
+			opts.size = std::strtoull(size.data(), nullptr, 10);
+		}
+		else if (arg == "--placement" && i + 1 < argc)
+		{
+			const std::string_view name(argv[++i]);
+			auto it = std::find(std::begin(sPlacementNames), std::end(sPlacementNames), name);
+			if (it == std::end(sPlacementNames))
+			{
+				std::cerr << "Error: unknown placement " << name << "\n";
+				std::exit(1);
+			}
+			opts.placement = static_cast<Placement>(it - std::begin(sPlacementNames));
+		}
+		else
+		{
+			std::cerr << "Usage: " << argv[0] << " [--count N] [--rounds N] [--capacity 2^n] [--size 16|64|256|1024|4096|element]"
+				<< " [--placement none|same-cpu|smt|core|socket] [--header]\n";
+			std::exit(1);
+		}
+	}
+
+	if (opts.count == 0 || opts.rounds == 0 || opts.capacity < 2 || (opts.capacity & (opts.capacity - 1)) != 0)
+	{
+		std::cerr << "Error: count and rounds have to be positive, and capacity power of two\n";
+		std::exit(1);
+	}
+	return opts;
+}
+
+inline void cpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	asm volatile("yield" ::: "memory");
+#endif
+}
+
+// Spin on another CPU, give the CPU away when the other side needs it to make progress
+inline void backoff(bool same_cpu)
+{
+	if (same_cpu)
+		sched_yield();
+	else
+		cpuRelax();
+}
+
+inline void printHeader()
+{
+	std::cout << std::left << std::setw(32) << "variant"
+		<< std::setw(14) << "placement"
+		<< std::right << std::setw(9) << "capacity"
+		<< std::setw(7) << "size"
+		<< std::setw(13) << "msgs/s"
+		<< std::setw(10) << "ns/msg"
+		<< std::setw(10) << "MB/s"
+		<< std::setw(11) << "rtt p50"
+		<< std::setw(11) << "rtt p99"
+		<< std::setw(11) << "rtt max" << "\n";
+}
+
+inline void printUnsupported(const char* variant, const Options& opts, std::size_t size, const char* reason)
+{
+	if (opts.header)
+		printHeader();
+	std::cout << std::left << std::setw(32) << variant
+		<< std::setw(14) << harness::placementName(harness::Options{ .placement = opts.placement })
+		<< std::right << std::setw(9) << opts.capacity
+		<< std::setw(7) << size
+		<< "  - " << reason << "\n";
+}
+
+// Both threads pin themselves, then wait for each other so neither starts timing alone
+class StartLine
+{
+public:
+	StartLine(int producer_cpu, int consumer_cpu) :
+		m_producer_cpu(producer_cpu),
+		m_consumer_cpu(consumer_cpu)
+	{
+	}
+
+	// Unless they are pinned to different CPUs, a waiting thread may hold up the very one it's waiting for
+	bool mayShareCpu() const
+	{
+		return m_producer_cpu == m_consumer_cpu;
+	}
+
+	// Return false if pinning failed
+	bool arrive(bool producer)
+	{
+		const int cpu = producer ? m_producer_cpu : m_consumer_cpu;
+		const bool pinned = cpu == -1 || lib::pinToCpu(cpu);
+
+		m_ready.fetch_add(1, std::memory_order_acq_rel);
+		while (m_ready.load(std::memory_order_acquire) < 2)
+			backoff(mayShareCpu());
+		return pinned;
+	}
+
+private:
+	int m_producer_cpu = -1;
+	int m_consumer_cpu = -1;
+	alignas(64) std::atomic<int> m_ready{0};
+};
+
+// Run both measurements and print the row.
+//
+// with_ring(idx, f) calls f(ring) with a new ring over ring 'idx' (0 or 1), each thread takes its own. Both rings
+// have 'opts.capacity' and hold T, which has to have 'sent_ns'. The rings have to support tryPut(const T&) and
+// get(T&), which return false while ring is full (or empty). Both sides wait the same way, see backoff(), rather than
+// with whatever waiting the ring does on its own, so only the ring itself is compared.
+template <typename T, typename WithRing>
+int run(const char* variant, const Options& opts, WithRing&& with_ring)
+{
+	int producer_cpu = -1;
+	int consumer_cpu = -1;
+	if (opts.placement != Placement::None && !harness::placementCpus(opts.placement, producer_cpu, consumer_cpu))
+	{
+		printUnsupported(variant, opts, sizeof(T), "no such pair of CPUs on this machine");
+		return 0;
+	}
+
+	// throughput over ring 0
+	std::uint64_t start_ns = 0;
+	std::uint64_t end_ns = 0;
+	std::atomic<bool> pinned{true};
+	{
+		StartLine start_line(producer_cpu, consumer_cpu);
+		const bool same_cpu = start_line.mayShareCpu();
+
+		std::thread producer([&]() {
+			with_ring(0, [&](auto& rb) {
+				if (!start_line.arrive(true))
+					pinned.store(false);
+				start_ns = bench::nowNs();
+
+				T msg;
+				std::memset(&msg, 'x', sizeof(msg));
+				for (std::uint64_t i=0; i<opts.count; ++i)
+				{
+					msg.sent_ns = i;
+					while (!rb.tryPut(msg))
+						backoff(same_cpu);
+				}
+			});
+		});
+
+		with_ring(0, [&](auto& rb) {
+			if (!start_line.arrive(false))
+				pinned.store(false);
+
+			T msg;
+			for (std::uint64_t received=0; received<opts.count; )
+			{
+				if (rb.get(msg))
+					++received;
+				else
+					backoff(same_cpu);
+			}
+			end_ns = bench::nowNs();
+		});
+		producer.join();
+	}
+
+	// round trip, producer sends over ring 0 and consumer echoes back over ring 1
+	lib::LatencyHistogram histogram;
+	{
+		StartLine start_line(producer_cpu, consumer_cpu);
+		const bool same_cpu = start_line.mayShareCpu();
+
+		std::thread echo([&]() {
+			with_ring(0, [&](auto& in) {
+				with_ring(1, [&](auto& out) {
+					if (!start_line.arrive(false))
+						pinned.store(false);
+
+					T msg;
+					for (std::uint64_t round=0; round<opts.rounds; ++round)
+					{
+						while (!in.get(msg))
+							backoff(same_cpu);
+						while (!out.tryPut(msg))
+							backoff(same_cpu);
+					}
+				});
+			});
+		});
+
+		with_ring(0, [&](auto& out) {
+			with_ring(1, [&](auto& in) {
+				if (!start_line.arrive(true))
+					pinned.store(false);
+
+				T msg;
+				std::memset(&msg, 'x', sizeof(msg));
+				for (std::uint64_t round=0; round<opts.rounds; ++round)
+				{
+					msg.sent_ns = bench::nowNs();
+					while (!out.tryPut(msg))
+						backoff(same_cpu);
+					while (!in.get(msg))
+						backoff(same_cpu);
+					histogram.record(bench::nowNs() - msg.sent_ns);
+				}
+			});
+		});
+		echo.join();
+	}
+
+	if (!pinned.load())
+		return 1;
+
+	const std::uint64_t elapsed_ns = end_ns - start_ns;
+
+	if (opts.header)
+		printHeader();
+	std::cout << std::left << std::setw(32) << variant
+		<< std::setw(14) << harness::placementName(harness::Options{ .placement = opts.placement })
+		<< std::right << std::setw(9) << opts.capacity
+		<< std::setw(7) << sizeof(T)
+		<< std::fixed << std::setprecision(0)
+		<< std::setw(13) << opts.count * 1e9 / elapsed_ns
+		<< std::setprecision(1)
+		<< std::setw(10) << static_cast<double>(elapsed_ns) / opts.count
+		<< std::setprecision(0)
+		<< std::setw(10) << opts.count * sizeof(T) * 1e3 / elapsed_ns
+		<< std::setw(11) << histogram.percentile(50.0)
+		<< std::setw(11) << histogram.percentile(99.0)
+		<< std::setw(11) << histogram.max() << "\n";
+
+	return 0;
+}
+
+};
@@ -15,9 +15,25 @@
 #include <thread>
 
 #include "lib.h"
+#include "seqlock.h"
 
 using namespace lib;
 
+#ifdef USE_SEQLOCK
+// what readers copy out as a whole
+struct Record
+{
+	char name[255];
+	int id;
+};
+
+struct SharedData
+{
+	// outside of the record, so it can be flipped from signal handler even if it interrupted an update
+	alignas(64) std::atomic<bool> operational;
+	SeqLocked<Record> record;
+};
+#else
 struct SharedData
 {
 	pthread_rwlock_t rwlock;
@@ -25,6 +41,7 @@ struct SharedData
 	int id;
 	bool operational;
 };
+#endif
 
 ShmFdClient* s_shm_fd_obj = nullptr;
 MMap* s_mmap = nullptr;
@@ -35,8 +52,10 @@ bool s_is_unlock = false;	// require to not block writer process
 // so we handle them here.
 void signal_handler(int signal)
 {
+#ifndef USE_SEQLOCK
 	if (s_ptr != nullptr && !s_is_unlock)
 		pthread_rwlock_unlock(&s_ptr->rwlock);
+#endif
 
 	// just make a copy
 	if (s_shm_fd_obj != nullptr)
@@ -90,6 +109,22 @@ int main()
 	bool operational = true;
 	while (operational)
 	{
+#ifdef USE_SEQLOCK
+		// copy out without taking any lock, and print from the copy so writer is never held back by us
+		Record record;
+		bool copied = ptr->record.tryLoad(record);
+		// retry while writer is in the middle of an update, unless it's gone in the middle of one
+		while (!copied && ptr->operational.load(std::memory_order_acquire))
+		{
+			sched_yield();
+			copied = ptr->record.tryLoad(record);
+		}
+
+		if (copied)
+			std::cout << "read - ID: " << record.id << ", name: " << record.name << std::endl;
+
+		operational = ptr->operational.load(std::memory_order_acquire);
+#else
 		pthread_rwlock_rdlock(&ptr->rwlock);
 		s_is_unlock = false;
 
@@ -98,6 +133,7 @@ int main()
 		pthread_rwlock_unlock(&ptr->rwlock);
 
 		s_is_unlock = true;
+#endif
 
 		// random delay time in ms
 		int delay_ms = dis(gen);
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <sched.h>
+#include <type_traits>
+
+namespace lib
+{
+
+// Single-writer sequence lock around a value of T, to be placed in shared memory.
+//
+// Writer bumps 'seq' to odd before updating the value and back to even after it, never waiting for anyone. Readers
+// copy the value optimistically and keep it only if 'seq' was even and unchanged across the copy, so they never
+// write to the shared cache lines and never hold writer back.
+// The value is kept as words of relaxed atomics, so racing reads are well-defined and simply retried.
+template <typename T>
+struct SeqLocked
+{
+	static_assert(std::is_trivially_copyable_v<T>, "T must be trivially copyable to be copied optimistically");
+
+	static constexpr std::size_t sWords = (sizeof(T) + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t);
+
+	// writer only, and only one of them
+	void store(const T& value)
+	{
+		std::uint64_t buf[sWords] = {};
+		std::memcpy(buf, &value, sizeof(T));
+
+		const std::uint32_t s = seq.load(std::memory_order_relaxed);
+		seq.store(s + 1, std::memory_order_relaxed);
+		// value stores can't move above the odd seq
+		std::atomic_thread_fence(std::memory_order_release);
+
+		for (std::size_t i=0; i<sWords; ++i)
+			words[i].store(buf[i], std::memory_order_relaxed);
+
+		seq.store(s + 2, std::memory_order_release);
+	}
+
+	// Single attempt, return false if writer was in the middle of an update
+	bool tryLoad(T& out) const
+	{
+		const std::uint32_t s1 = seq.load(std::memory_order_acquire);
+		if (s1 & 1)
+			return false;
+
+		std::uint64_t buf[sWords];
+		for (std::size_t i=0; i<sWords; ++i)
+			buf[i] = words[i].load(std::memory_order_relaxed);
+
+		// value loads can't move below the second read of seq
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (seq.load(std::memory_order_relaxed) != s1)
+			return false;
+
+		std::memcpy(&out, buf, sizeof(T));
+		return true;
+	}
+
+	// Retry until a consistent copy is taken. Spins forever if writer died in the middle of an update.
+	T load() const
+	{
+		T out;
+		while (!tryLoad(out))
+			sched_yield();
+		return out;
+	}
+
+	// even when stable, odd while writer is updating the value
+	alignas(64) std::atomic<std::uint32_t> seq;
+	std::atomic<std::uint64_t> words[sWords];
+};
+
+};
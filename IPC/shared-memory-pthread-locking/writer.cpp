@@ -18,9 +18,25 @@
 #include <random>
 
 #include "lib.h"
+#include "seqlock.h"
 
 using namespace lib;
 
+#ifdef USE_SEQLOCK
+// what readers copy out as a whole
+struct Record
+{
+	char name[255];
+	int id;
+};
+
+struct SharedData
+{
+	// outside of the record, so it can be flipped from signal handler even if it interrupted an update
+	alignas(64) std::atomic<bool> operational;
+	SeqLocked<Record> record;
+};
+#else
 struct SharedData
 {
 	pthread_rwlock_t rwlock;
@@ -28,6 +44,7 @@ struct SharedData
 	int id;
 	bool operational;
 };
+#endif
 
 static bool s_still_operate = true;
 
@@ -42,6 +59,10 @@ void signal_handler(int signal)
 {
 	s_still_operate = false;
 
+#ifdef USE_SEQLOCK
+	if (s_ptr != nullptr)
+		s_ptr->operational.store(false, std::memory_order_release);	// to signal other processes that writer process has down
+#else
 	if (s_ptr != nullptr)
 	{
 		if (s_is_unlock)
@@ -52,6 +73,7 @@ void signal_handler(int signal)
 		pthread_rwlock_unlock(&s_ptr->rwlock);
 		pthread_rwlock_destroy(&s_ptr->rwlock);
 	}
+#endif
 
 	// destroy the lock
 	if (s_ptr != nullptr && !s_is_unlock)
@@ -107,11 +129,13 @@ int main()
 	MMap mmap(ptr, SIZE);
 	s_mmap = &mmap;
 
+#ifndef USE_SEQLOCK
 	// initialize rwlock for inter-process (only initialize in writer process)
 	pthread_rwlockattr_t attr;
 	pthread_rwlockattr_init(&attr);
 	pthread_rwlockattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
 	pthread_rwlock_init(&ptr->rwlock, &attr);
+#endif
 
 	int increment_id = 0;
 	while (s_still_operate)
@@ -121,6 +145,18 @@ int main()
 		if (!s_still_operate)
 			break;
 
+#ifdef USE_SEQLOCK
+		// prepare it locally, then publish as a whole without waiting for readers
+		Record record;
+		record.id = increment_id++;
+		std::strcpy(record.name, "hello world");
+		ptr->record.store(record);
+
+		if (!ptr->operational.load(std::memory_order_relaxed))
+			ptr->operational.store(true, std::memory_order_release);
+
+		std::cout << "wrote - ID:" << record.id << ", name: " << record.name << std::endl;
+#else
 		pthread_rwlock_wrlock(&ptr->rwlock);
 		s_is_unlock = false;
 
@@ -136,6 +172,7 @@ int main()
 		s_is_unlock = true;
 
 		std::cout << "wrote - ID:" << ptr->id << ", name: " << ptr->name << std::endl;
+#endif
 
 		// random delay time in ms
 		int delay_ms = dis(gen);
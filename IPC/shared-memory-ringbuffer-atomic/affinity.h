@@ -0,0 +1,96 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <charconv>
+#include <cstddef>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/mempolicy.h>
+
+// Placement of writer/reader processes on CPUs and of the segment's memory on NUMA nodes.
+//
+// Whether writer and reader share a core, are hyperthread siblings, or sit on different sockets decides how far
+// ring's cache lines have to travel, so it's better chosen than left to the scheduler.
+namespace lib
+{
+
+// Parse CPU list in the format of taskset/cpuset, ex. "0,2-3". Return false if it's malformed or empty.
+inline bool parseCpuList(std::string_view list, cpu_set_t& cpus)
+{
+	CPU_ZERO(&cpus);
+	while (!list.empty())
+	{
+		const std::size_t comma = list.find(',');
+		const std::string_view item = list.substr(0, comma);
+		list = comma == std::string_view::npos ? std::string_view() : list.substr(comma + 1);
+
+		int first = 0;
+		int last = 0;
+		const char* end = item.data() + item.size();
+		auto [p, ec] = std::from_chars(item.data(), end, first);
+		if (ec != std::errc() || first < 0)
+			return false;
+		last = first;
+		if (p != end && *p == '-')
+		{
+			auto [p2, ec2] = std::from_chars(p + 1, end, last);
+			if (ec2 != std::errc())
+				return false;
+			p = p2;
+		}
+		if (p != end || last < first || last >= CPU_SETSIZE)
+			return false;
+
+		for (int cpu=first; cpu<=last; ++cpu)
+			CPU_SET(cpu, &cpus);
+	}
+	return CPU_COUNT(&cpus) > 0;
+}
+
+// Pin calling process (its calling thread, and whatever it forks or spawns later) to 'cpus'
+inline bool pinToCpus(const cpu_set_t& cpus)
+{
+	if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0)
+	{
+		std::cerr << "sched_setaffinity() failed, CPU not available?\n";
+		return false;
+	}
+	return true;
+}
+
+inline bool pinToCpu(int cpu)
+{
+	cpu_set_t cpus;
+	CPU_ZERO(&cpus);
+	CPU_SET(cpu, &cpus);
+	return pinToCpus(cpus);
+}
+
+// Set memory policy of [ptr, ptr + size) so its pages come from NUMA node 'node' only. For a shared mapping policy
+// belongs to the segment itself, so it holds for everyone mapping it. Has to be done before pages are faulted in,
+// pages already there are migrated if possible.
+// Called through syscall() to not depend on libnuma.
+inline bool bindToNode(void* ptr, std::size_t size, int node)
+{
+	if (node < 0 || node >= static_cast<int>(sizeof(unsigned long) * 8))
+		return false;
+
+	const unsigned long nodemask = 1ul << node;
+	// maxnode counts one past the last bit, as libnuma passes it
+	return syscall(SYS_mbind, ptr, size, MPOL_BIND, &nodemask, sizeof(nodemask) * 8 + 1, MPOL_MF_MOVE) == 0;
+}
+
+// Where 'cpu' sits, from sysfs. Return false if it's not known.
+inline bool cpuTopology(int cpu, int& package, int& core)
+{
+	const std::string dir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/";
+	std::ifstream package_file(dir + "physical_package_id");
+	std::ifstream core_file(dir + "core_id");
+	return static_cast<bool>(package_file >> package) && static_cast<bool>(core_file >> core);
+}
+
+};
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <iostream>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Helpers shared by bench_*.cpp
+namespace bench
+{
+
+inline std::uint64_t nowNs()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Anonymous shared mapping which survives fork(), so child processes talk to parent through it the same way writer
+// and reader do through shm_open(). Value-initialized as a fresh shm segment is zero-filled.
+template <typename T>
+T* mapShared()
+{
+	void* ptr = mmap(0, sizeof(T), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (ptr == MAP_FAILED)
+	{
+		std::cerr << "mmap() failed\n";
+		std::exit(1);
+	}
+	return new (ptr) T();
+}
+
+template <typename T>
+void unmapShared(T* ptr)
+{
+	ptr->~T();
+	munmap(ptr, sizeof(T));
+}
+
+// As mapShared(), for 'n' elements sized at runtime
+template <typename T>
+T* mapSharedArray(std::size_t n)
+{
+	void* ptr = mmap(0, sizeof(T) * n, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (ptr == MAP_FAILED)
+	{
+		std::cerr << "mmap() failed\n";
+		std::exit(1);
+	}
+	T* elems = static_cast<T*>(ptr);
+	for (std::size_t i=0; i<n; ++i)
+		new (elems + i) T();
+	return elems;
+}
+
+template <typename T>
+void unmapSharedArray(T* ptr, std::size_t n)
+{
+	for (std::size_t i=0; i<n; ++i)
+		ptr[i].~T();
+	munmap(ptr, sizeof(T) * n);
+}
+
+// Run 'f' in a child process, return its pid
+template <typename F>
+pid_t spawn(F&& f)
+{
+	pid_t pid = fork();
+	if (pid == -1)
+	{
+		std::cerr << "fork() failed\n";
+		std::exit(1);
+	}
+	if (pid == 0)
+	{
+		f();
+		std::_Exit(0);
+	}
+	return pid;
+}
+
+inline void waitAll()
+{
+	while (wait(nullptr) > 0)
+		;
+}
+
+};
@@ -0,0 +1,93 @@
+/**
+ * Benchmark of IndexCaching::Local against IndexCaching::None.
+ *
+ * Producer (this process) and consumer (forked child) pass 'count' 8-byte messages through a ring living in an
+ * anonymous shared mapping, one message per call. With IndexCaching::None every call loads both head and tail,
+ * with IndexCaching::Local each side mostly stays on its own index cache line.
+ * Pin the two processes on different cores (e.g. via taskset) to see cross-core traffic.
+ *
+ * Usage: ./bench-cached [count]
+ */
+#include <iostream>
+#include <cstdint>
+#include <cstdlib>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "lib.h"
+#include "ringbuffer.h"
+#include "bench.h"
+
+using namespace lib;
+
+namespace
+{
+
+struct Shared
+{
+	RingBufferCtrlFields ctrl;
+	alignas(64) std::uint64_t elems[sElementSize];
+};
+
+template <IndexCaching Caching>
+double run(long count)
+{
+	using Ring = BasicRingBuffer<std::uint64_t, sElementSize, Caching>;
+
+	Shared* shared = bench::mapShared<Shared>();
+
+	bench::spawn([&]() {
+		Ring rb(shared->elems, &shared->ctrl.head, &shared->ctrl.tail);
+		std::uint64_t v = 0;
+		for (long i=0; i<count; )
+		{
+			if (!rb.get(v))
+			{
+				sched_yield();
+				continue;
+			}
+			if (v != static_cast<std::uint64_t>(i))
+			{
+				std::cerr << "out of order: expected " << i << ", got " << v << "\n";
+				std::_Exit(1);
+			}
+			++i;
+		}
+	});
+
+	Ring rb(shared->elems, &shared->ctrl.head, &shared->ctrl.tail);
+	std::uint64_t start = bench::nowNs();
+	for (long i=0; i<count; )
+	{
+		if (!rb.tryPut(i))
+		{
+			sched_yield();
+			continue;
+		}
+		++i;
+	}
+	bench::waitAll();
+	std::uint64_t end = bench::nowNs();
+
+	bench::unmapShared(shared);
+	return static_cast<double>(end - start) / count;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+	long count = 10'000'000;
+	if (argc > 1)
+		count = std::atol(argv[1]);
+
+	double none_ns = run<IndexCaching::None>(count);
+	double local_ns = run<IndexCaching::Local>(count);
+
+	std::cout << "messages: " << count << "\n";
+	std::cout << "IndexCaching::None  - " << none_ns << " ns/msg, " << 1e3 / none_ns << " Mmsg/s\n";
+	std::cout << "IndexCaching::Local - " << local_ns << " ns/msg, " << 1e3 / local_ns << " Mmsg/s\n";
+
+	return 0;
+}
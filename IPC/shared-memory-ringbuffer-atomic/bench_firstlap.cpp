@@ -0,0 +1,166 @@
+/**
+ * Benchmark of page faults during the first lap over a fresh segment.
+ *
+ * For each way of backing the segment (normal pages faulted in lazily, normal pages prefaulted and locked, huge pages
+ * prefaulted and locked), writer creates a fresh segment the same way writer does and a forked reader attaches to it.
+ * Writer puts two laps of ElementData through RingBuffer while reader gets them, and the cost of each successful
+ * tryPut() and get() goes into a histogram of its lap. Only the first lap touches pages for the first time, so the
+ * difference between the two laps is what page faults cost. Minor page faults of both processes are reported too.
+ *
+ * Huge pages need hugetlbfs mounted on /dev/hugepages and pages reserved (vm.nr_hugepages), otherwise that mode falls
+ * back to normal pages as writer does.
+ *
+ * Usage: ./bench-firstlap [capacity]
+ */
+#include <iostream>
+#include <iomanip>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "lib.h"
+#include "ringbuffer.h"
+#include "segment.h"
+#include "histogram.h"
+#include "bench.h"
+
+using namespace lib;
+
+namespace
+{
+
+const char* const sBenchSegmentName = "/osimhen-firstlap";
+
+struct LapStats
+{
+	LatencyHistogram put[2];
+	LatencyHistogram get[2];
+};
+
+void printLap(const char* mode, int lap, const LapStats& stats, long writer_faults, long reader_faults)
+{
+	std::cout << std::left << std::setw(22) << mode << std::right << std::setw(4) << lap + 1
+		<< std::setw(10) << stats.put[lap].percentile(50.0)
+		<< std::setw(10) << stats.put[lap].percentile(99.9)
+		<< std::setw(10) << stats.put[lap].max()
+		<< std::setw(10) << stats.get[lap].percentile(50.0)
+		<< std::setw(10) << stats.get[lap].percentile(99.9)
+		<< std::setw(10) << stats.get[lap].max();
+	if (lap == 0)
+		std::cout << std::setw(12) << writer_faults << std::setw(12) << reader_faults;
+	std::cout << "\n";
+}
+
+void runMode(const char* mode, const MapOptions& opts, std::size_t capacity)
+{
+	LapStats* stats = bench::mapShared<LapStats>();
+
+	Segment segment;
+	if (!createSegment(sBenchSegmentName, segmentSize(capacity), opts, segment))
+		std::exit(1);
+
+	SharedData* ptr = static_cast<SharedData*>(segment.ptr);
+	initHeader(ptr, capacity);
+
+	const std::uint64_t total = 2 * capacity;
+
+	pid_t reader_pid = bench::spawn([&]() {
+		Segment attached;
+		if (!attachSegment(sBenchSegmentName, opts, attached))
+			std::_Exit(1);
+
+		SharedData* rptr = static_cast<SharedData*>(attached.ptr);
+		RingBuffer rb(ringElements(rptr), rptr->header.capacity, &rptr->rb_ctrl_fields);
+
+		ElementData data;
+		for (std::uint64_t received=0; received<total; )
+		{
+			const std::uint64_t start = bench::nowNs();
+			const bool res = rb.get(data);
+			const std::uint64_t end = bench::nowNs();
+			if (!res)
+			{
+				sched_yield();
+				continue;
+			}
+
+			stats->get[static_cast<std::uint64_t>(data.id) < capacity ? 0 : 1].record(end - start);
+			++received;
+		}
+	});
+
+	// writer stays in this process as it created the segment, faults are counted from rusage around the loop
+	rusage before;
+	getrusage(RUSAGE_SELF, &before);
+
+	RingBuffer rb(ringElements(ptr), capacity, &ptr->rb_ctrl_fields);
+	ElementData elem_data;
+	std::strcpy(elem_data.name, "hello world");
+	for (std::uint64_t i=0; i<total; )
+	{
+		elem_data.id = static_cast<int>(i);
+
+		const std::uint64_t start = bench::nowNs();
+		const bool res = rb.tryPut(elem_data);
+		const std::uint64_t end = bench::nowNs();
+		if (!res)
+		{
+			sched_yield();
+			continue;
+		}
+
+		stats->put[i < capacity ? 0 : 1].record(end - start);
+		++i;
+	}
+
+	rusage after;
+	getrusage(RUSAGE_SELF, &after);
+
+	int status = 0;
+	rusage reader_usage;
+	wait4(reader_pid, &status, 0, &reader_usage);
+
+	printLap(mode, 0, *stats, after.ru_minflt - before.ru_minflt, reader_usage.ru_minflt);
+	printLap(mode, 1, *stats, 0, 0);
+
+	munmap(segment.ptr, segment.size);
+	close(segment.fd);
+	if (segment.file_path.empty())
+		shm_unlink(sBenchSegmentName);
+	else
+		unlink(segment.file_path.c_str());
+
+	bench::unmapShared(stats);
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+	std::size_t capacity = 65536;
+	if (argc > 1)
+		capacity = std::strtoull(argv[1], nullptr, 10);
+
+	if (capacity < 2 || (capacity & (capacity - 1)) != 0)
+	{
+		std::cerr << "capacity must be power of two\n";
+		return 1;
+	}
+
+	std::cout << "capacity: " << capacity << ", segment: " << segmentSize(capacity) << " bytes, costs in ns\n";
+	std::cout << std::left << std::setw(22) << "mode" << std::right << std::setw(4) << "lap"
+		<< std::setw(10) << "put p50" << std::setw(10) << "put p99.9" << std::setw(10) << "put max"
+		<< std::setw(10) << "get p50" << std::setw(10) << "get p99.9" << std::setw(10) << "get max"
+		<< std::setw(12) << "w faults" << std::setw(12) << "r faults" << "\n";
+
+	runMode("lazy", MapOptions{false, false}, capacity);
+	runMode("prefault", MapOptions{false, true}, capacity);
+	runMode("hugepages+prefault", MapOptions{true, true}, capacity);
+
+	return 0;
+}
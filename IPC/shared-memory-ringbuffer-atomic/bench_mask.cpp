@@ -0,0 +1,140 @@
+/**
+ * Benchmark of index wrapping in the ring buffer.
+ *
+ * Compare the previous runtime-sized ring (index wrapped with '%' by 500) against BasicRingBuffer whose power-of-two
+ * capacity is known at compile time (index wrapped with a bitmask). Both run single-threaded in this process, so no
+ * cross-core traffic is measured. 'index advance' is the wrapping alone. 'put+get on ring' is the whole ring, and
+ * BasicRingBuffer does more there than wrap: it checks for stats counters, a tracer and futex/eventfd waiters on every
+ * operation. None are wired up here, so each is a branch that's never taken, but it's not free.
+ *
+ * Usage: ./bench-mask [iterations]
+ */
+#include <iostream>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <atomic>
+#include <array>
+
+#include "lib.h"
+#include "ringbuffer.h"
+
+using namespace lib;
+
+namespace
+{
+
+// index math of the ring before it was templated, runtime size and wrapping with '%'
+struct ModuloRing
+{
+	ModuloRing(std::uint64_t* buffer, int buffer_size, std::atomic<int>* head, std::atomic<int>* tail) :
+		m_buffer(buffer),
+		m_buffer_size(buffer_size),
+		m_head(head),
+		m_tail(tail)
+	{}
+
+	bool put(std::uint64_t v)
+	{
+		const size_t s = m_buffer_size;
+		if (((s + m_head->load(std::memory_order_acquire) - m_tail->load(std::memory_order_acquire)) % s) + 1 >= s)
+			return false;
+
+		int head = m_head->load(std::memory_order_acquire);
+		m_buffer[head] = v;
+		m_head->store((head + 1) % m_buffer_size, std::memory_order_release);
+		return true;
+	}
+
+	bool get(std::uint64_t& v)
+	{
+		const size_t s = m_buffer_size;
+		int head = m_head->load(std::memory_order_acquire);
+		int tail = m_tail->load(std::memory_order_acquire);
+		if (((s + head - tail) % s) + 1 < s && head == tail)
+			return false;
+
+		v = m_buffer[tail];
+		m_tail->store((tail + 1) % m_buffer_size, std::memory_order_release);
+		return true;
+	}
+
+	std::uint64_t* m_buffer;
+	const int m_buffer_size;
+	std::atomic<int>* m_head;
+	std::atomic<int>* m_tail;
+};
+
+template <typename F>
+double measureNsPerOp(long iterations, F&& f)
+{
+	auto start = std::chrono::steady_clock::now();
+	f();
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+	long iterations = 50'000'000;
+	if (argc > 1)
+		iterations = std::atol(argv[1]);
+
+	// read through volatile so compiler can't fold the divisor into a multiply, as with runtime size of the old ring
+	volatile int runtime_size = 500;
+	const int size = runtime_size;
+
+	// 1. index advance only, each step depends on the previous one
+	int idx = 0;
+	double mod_ns = measureNsPerOp(iterations, [&]() {
+		for (long i=0; i<iterations; ++i)
+			idx = (idx + 1) % size;
+	});
+	int sink = idx;
+
+	idx = 0;
+	double mask_ns = measureNsPerOp(iterations, [&]() {
+		for (long i=0; i<iterations; ++i)
+			idx = (idx + 1) & (sElementSize - 1);
+	});
+	sink += idx;
+
+	// 2. put followed by get through the whole ring
+	alignas(64) static std::array<std::uint64_t, sElementSize> buffer;
+	alignas(64) std::atomic<int> head{0};
+	alignas(64) std::atomic<int> tail{0};
+
+	std::uint64_t v = 0;
+	std::uint64_t sum = 0;
+
+	ModuloRing mod_ring(buffer.data(), size, &head, &tail);
+	double mod_ring_ns = measureNsPerOp(iterations, [&]() {
+		for (long i=0; i<iterations; ++i)
+		{
+			mod_ring.put(i);
+			mod_ring.get(v);
+			sum += v;
+		}
+	});
+
+	// same loads of head and tail as ModuloRing, but free-running positions wrapped into slots by mask
+	alignas(64) std::atomic<std::uint64_t> seq_head{0};
+	alignas(64) std::atomic<std::uint64_t> seq_tail{0};
+	BasicRingBuffer<std::uint64_t, sElementSize, IndexCaching::None> mask_ring(buffer.data(), &seq_head, &seq_tail);
+	double mask_ring_ns = measureNsPerOp(iterations, [&]() {
+		for (long i=0; i<iterations; ++i)
+		{
+			mask_ring.tryPut(i);
+			mask_ring.get(v);
+			sum += v;
+		}
+	});
+
+	std::cout << "iterations: " << iterations << " (sink " << sink + sum << ")\n";
+	std::cout << "index advance   - modulo(" << size << "): " << mod_ns << " ns/op, mask(" << sElementSize << "): " << mask_ns << " ns/op\n";
+	std::cout << "put+get on ring - modulo(" << size << "): " << mod_ring_ns << " ns/op, mask(" << sElementSize << "): " << mask_ring_ns << " ns/op\n";
+
+	return 0;
+}
@@ -0,0 +1,172 @@
+/**
+ * Contention benchmark of MPMCRingBuffer.
+ *
+ * Producers and readers are forked processes talking through SharedData in an anonymous shared mapping, as writer
+ * and reader do. For every reader count from 1 to the number of online cores, producers push 'count' ElementData
+ * in total, then one stop element per reader (id == -1) is pushed once all producers are done.
+ * Readers mark every id they take in flags shared by all of them and fail on one already marked, afterwards every
+ * id produced has to be marked, so nothing is lost or duplicated.
+ *
+ * Usage: ./bench-mpmc [count] [producers] [max-readers]
+ */
+#include <iostream>
+#include <iomanip>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <vector>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "lib.h"
+#include "mpmc_ringbuffer.h"
+#include "bench.h"
+
+using namespace lib;
+
+namespace
+{
+
+const int sMaxReaders = 256;
+
+struct ReaderStats
+{
+	alignas(64) std::uint64_t taken;
+};
+
+struct Shared
+{
+	SharedData data;
+	ReaderStats stats[sMaxReaders];
+};
+
+using Ring = MPMCRingBuffer<ElementData, sElementSize>;
+
+void runProducer(Shared* shared, long begin, long end)
+{
+	Ring rb(shared->data.mpmc_elems, &shared->data.mpmc_ctrl_fields);
+	ElementData elem_data;
+	std::strcpy(elem_data.name, "hello world");
+	for (long i=begin; i<end; ++i)
+	{
+		elem_data.id = static_cast<int>(i);
+		rb.put(elem_data);
+	}
+}
+
+// 'seen' has a flag per id produced
+void runReader(Shared* shared, std::atomic<std::uint8_t>* seen, long count, int reader_idx)
+{
+	Ring rb(shared->data.mpmc_elems, &shared->data.mpmc_ctrl_fields);
+	ElementData data;
+	ReaderStats stats = {};
+	for (;;)
+	{
+		if (!rb.get(data))
+		{
+			sched_yield();
+			continue;
+		}
+		if (data.id == -1)
+			break;
+
+		if (data.id < 0 || data.id >= count)
+		{
+			std::cerr << "reader " << reader_idx << " got id " << data.id << " which was never produced\n";
+			std::_Exit(1);
+		}
+		// whoever marks it second has got an element taken before, by itself or another reader
+		if (seen[data.id].exchange(1, std::memory_order_relaxed) != 0)
+		{
+			std::cerr << "reader " << reader_idx << " got id " << data.id << " which was already taken\n";
+			std::_Exit(1);
+		}
+
+		++stats.taken;
+	}
+	shared->stats[reader_idx] = stats;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+	long count = 2'000'000;
+	int producers = 1;
+	if (argc > 1)
+		count = std::atol(argv[1]);
+	if (argc > 2)
+		producers = std::atoi(argv[2]);
+
+	int max_readers = static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+	if (argc > 3)
+		max_readers = std::atoi(argv[3]);
+	if (max_readers > sMaxReaders)
+		max_readers = sMaxReaders;
+
+	std::cout << "messages: " << count << ", producers: " << producers << ", element size: " << sizeof(ElementData) << " bytes\n";
+	std::cout << std::setw(8) << "readers" << std::setw(14) << "ns/msg" << std::setw(14) << "Mmsg/s"
+		<< std::setw(14) << "min share" << std::setw(14) << "max share" << "\n";
+
+	for (int readers=1; readers<=max_readers; ++readers)
+	{
+		Shared* shared = bench::mapShared<Shared>();
+		std::atomic<std::uint8_t>* seen = bench::mapSharedArray<std::atomic<std::uint8_t>>(count);
+		Ring rb(shared->data.mpmc_elems, &shared->data.mpmc_ctrl_fields);
+		rb.init();
+
+		std::uint64_t start = bench::nowNs();
+
+		std::vector<pid_t> reader_pids;
+		for (int r=0; r<readers; ++r)
+			reader_pids.push_back(bench::spawn([=]() { runReader(shared, seen, count, r); }));
+
+		std::vector<pid_t> producer_pids;
+		for (int p=0; p<producers; ++p)
+		{
+			const long begin = count * p / producers;
+			const long end = count * (p + 1) / producers;
+			producer_pids.push_back(bench::spawn([=]() { runProducer(shared, begin, end); }));
+		}
+		for (pid_t pid : producer_pids)
+			waitpid(pid, nullptr, 0);
+
+		ElementData stop = {};
+		stop.id = -1;
+		for (int r=0; r<readers; ++r)
+			rb.put(stop);
+		bench::waitAll();
+
+		std::uint64_t end = bench::nowNs();
+
+		std::uint64_t taken = 0;
+		std::uint64_t min_taken = UINT64_MAX;
+		std::uint64_t max_taken = 0;
+		for (int r=0; r<readers; ++r)
+		{
+			taken += shared->stats[r].taken;
+			min_taken = std::min(min_taken, shared->stats[r].taken);
+			max_taken = std::max(max_taken, shared->stats[r].taken);
+		}
+		long missing = 0;
+		for (long id=0; id<count; ++id)
+			missing += seen[id].load(std::memory_order_relaxed) == 0;
+		bench::unmapSharedArray(seen, count);
+		bench::unmapShared(shared);
+
+		// a reader that got a duplicate exits without reporting what it took, so its share is missing from 'taken'
+		if (missing != 0 || taken != static_cast<std::uint64_t>(count))
+		{
+			std::cerr << "lost or duplicated elements: " << missing << " ids never taken, " << taken << " taken of " << count << "\n";
+			return 1;
+		}
+
+		const double ns_per_msg = static_cast<double>(end - start) / count;
+		std::cout << std::setw(8) << readers << std::setw(14) << ns_per_msg << std::setw(14) << 1e3 / ns_per_msg
+			<< std::setw(13) << 100.0 * min_taken / count << "%" << std::setw(13) << 100.0 * max_taken / count << "%\n";
+	}
+
+	return 0;
+}
@@ -0,0 +1,146 @@
+/**
+ * Benchmark of FullPolicy with a consumer slower than producer.
+ *
+ * Producer (this process) put()s 'count' ElementData as fast as it can, consumer (forked child) spends 'work' ns
+ * on every element it gets, so the ring is full most of the time. Per policy it reports producer's rate and
+ * cost of put(), and how many elements consumer got, producer dropped, or consumer lost to producer.
+ * Consumer also checks that whatever it gets is in order.
+ *
+ * Usage: ./bench-policy [count] [work ns]
+ */
+#include <iostream>
+#include <iomanip>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "lib.h"
+#include "ringbuffer.h"
+#include "histogram.h"
+#include "bench.h"
+
+using namespace lib;
+
+namespace
+{
+
+const std::size_t sCapacity = 1024;
+
+struct Shared
+{
+	RingBufferCtrlFields ctrl;
+	alignas(64) ElementData elems[sCapacity];
+	alignas(64) std::atomic<std::uint64_t> seqs[sCapacity];
+
+	alignas(64) std::atomic<bool> ready;
+	std::atomic<bool> done;
+	std::uint64_t received;
+};
+
+void busyFor(std::uint64_t ns)
+{
+	const std::uint64_t until = bench::nowNs() + ns;
+	while (bench::nowNs() < until)
+		;
+}
+
+template <FullPolicy Policy>
+void run(const char* name, long count, std::uint64_t work_ns)
+{
+	using Ring = BasicRingBuffer<ElementData, sCapacity, IndexCaching::Local, Policy>;
+
+	Shared* shared = bench::mapShared<Shared>();
+
+	pid_t pid = bench::spawn([&]() {
+		Ring rb(shared->elems, shared->seqs, sCapacity, &shared->ctrl);
+		shared->ready.store(true, std::memory_order_release);
+
+		ElementData data;
+		int last_id = -1;
+		std::uint64_t received = 0;
+		while (true)
+		{
+			const bool done = shared->done.load(std::memory_order_acquire);
+			if (!rb.get(data))
+			{
+				if (done)
+					break;
+				sched_yield();
+				continue;
+			}
+
+			if (data.id <= last_id)
+			{
+				std::cerr << "out of order: " << data.id << " after " << last_id << "\n";
+				std::_Exit(1);
+			}
+			last_id = data.id;
+			++received;
+			busyFor(work_ns);
+		}
+		shared->received = received;
+	});
+
+	// consumer has to be there from the first element, or it starts from wherever producer is when it joins
+	while (!shared->ready.load(std::memory_order_acquire))
+		sched_yield();
+
+	Ring rb(shared->elems, shared->seqs, sCapacity, &shared->ctrl);
+	LatencyHistogram histogram;
+	ElementData elem_data;
+	std::strcpy(elem_data.name, "hello world");
+
+	const std::uint64_t start = bench::nowNs();
+	for (long i=0; i<count; ++i)
+	{
+		elem_data.id = static_cast<int>(i);
+
+		const std::uint64_t put_start = bench::nowNs();
+		rb.put(elem_data);
+		histogram.record(bench::nowNs() - put_start);
+	}
+	const std::uint64_t elapsed = bench::nowNs() - start;
+
+	shared->done.store(true, std::memory_order_release);
+	int status = 0;
+	waitpid(pid, &status, 0);
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+		std::exit(1);
+
+	std::cout << std::left << std::setw(18) << name << std::right
+		<< std::setw(12) << static_cast<std::uint64_t>(count * 1e9 / elapsed)
+		<< std::setw(10) << histogram.percentile(50.0)
+		<< std::setw(10) << histogram.percentile(99.9)
+		<< std::setw(12) << histogram.max()
+		<< std::setw(12) << shared->received
+		<< std::setw(12) << rb.dropped()
+		<< std::setw(12) << rb.overwritten() << "\n";
+
+	bench::unmapShared(shared);
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+	long count = 1'000'000;
+	std::uint64_t work_ns = 500;
+	if (argc > 1)
+		count = std::atol(argv[1]);
+	if (argc > 2)
+		work_ns = std::strtoull(argv[2], nullptr, 10);
+
+	std::cout << "count: " << count << ", capacity: " << sCapacity << ", consumer work: " << work_ns << " ns per element\n";
+	std::cout << std::left << std::setw(18) << "policy" << std::right
+		<< std::setw(12) << "puts/s" << std::setw(10) << "put p50" << std::setw(10) << "put p99.9" << std::setw(12) << "put max"
+		<< std::setw(12) << "received" << std::setw(12) << "dropped" << std::setw(12) << "overwritten" << "\n";
+
+	run<FullPolicy::Block>("block", count, work_ns);
+	run<FullPolicy::DropNewest>("drop-newest", count, work_ns);
+	run<FullPolicy::OverwriteOldest>("overwrite-oldest", count, work_ns);
+	return 0;
+}
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <sched.h>
+#include <stdexcept>
+#include <type_traits>
+
+#include "lib.h"
+
+using namespace lib;
+
+// Broadcast (fan-out) ring buffer, every registered reader gets every element.
+//
+// Writer owns 'head' and the elements, each reader owns a cursor in BroadcastCtrlFields which is the position of
+// the next element it's going to read. Readers never write anything else, so data region can be mapped read-only
+// on their side. Writer won't overwrite an element until the slowest active reader has moved past it.
+//
+// Positions only grow and never wrap, slot index is derived by masking.
+//
+// NOTE: a reader which dies without unregistering keeps holding back writer, as its cursor stays active.
+
+template <typename T, std::size_t Capacity, std::size_t MaxReaders = sMaxBroadcastReaders>
+class BroadcastWriter
+{
+	static_assert(Capacity > 1 && (Capacity & (Capacity - 1)) == 0, "Capacity must be power of two");
+	static_assert(std::is_trivially_copyable_v<T>, "T must be trivially copyable to live in shared memory");
+
+	static constexpr std::uint64_t sMask = Capacity - 1;
+
+public:
+	BroadcastWriter(BroadcastData<T, Capacity>* data_ptr, BroadcastCursor* cursors_ptr) :
+		m_data(data_ptr),
+		m_cursors(cursors_ptr)
+	{
+		assert(m_data != nullptr);
+		assert(m_cursors != nullptr);
+
+		m_cached_min = m_data->head.load(std::memory_order_relaxed);
+	}
+
+	// not safe to call while there are readers
+	void init()
+	{
+		for (std::size_t i=0; i<MaxReaders; ++i)
+		{
+			m_cursors[i].pos.store(0, std::memory_order_relaxed);
+			m_cursors[i].state.store(BroadcastCursor::Free, std::memory_order_relaxed);
+		}
+		m_data->head.store(0, std::memory_order_release);
+		m_cached_min = 0;
+	}
+
+	// Return false if the slowest reader is a whole ring behind
+	bool tryPut(const T& obj)
+	{
+		// only writer modifies head
+		const std::uint64_t head = m_data->head.load(std::memory_order_relaxed);
+
+		// re-scan cursors only when cached view of the slowest reader says full
+		if (head - m_cached_min >= Capacity)
+		{
+			m_cached_min = _minCursor(head);
+			if (head - m_cached_min >= Capacity)
+				return false;
+		}
+
+		m_data->elems[head & sMask] = obj;
+		m_data->head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	void put(const T& obj)
+	{
+		while (!tryPut(obj))
+		{
+			// relinquish the current thread, so more chance that the slowest reader gets to run
+			sched_yield();
+		}
+	}
+
+private:
+	// position of the slowest active reader, or head if there is none
+	std::uint64_t _minCursor(std::uint64_t head)
+	{
+		// pairs with the fence in BroadcastReader's registration, so either we see the new reader active
+		// or it sees our latest head
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		std::uint64_t min = head;
+		for (std::size_t i=0; i<MaxReaders; ++i)
+		{
+			if (m_cursors[i].state.load(std::memory_order_acquire) != BroadcastCursor::Active)
+				continue;
+
+			const std::uint64_t pos = m_cursors[i].pos.load(std::memory_order_acquire);
+			if (pos < min)
+				min = pos;
+		}
+		return min;
+	}
+
+	// disable copy-construct, and assignment operator
+	BroadcastWriter(const BroadcastWriter&);
+	BroadcastWriter(BroadcastWriter&&);
+	BroadcastWriter& operator=(BroadcastWriter&);
+	BroadcastWriter& operator=(BroadcastWriter&&);
+
+private:
+	BroadcastData<T, Capacity>* m_data = nullptr;
+	BroadcastCursor* m_cursors = nullptr;
+
+	// process-local position of the slowest reader as of the last scan
+	std::uint64_t m_cached_min = 0;
+};
+
+// Registers itself into a free cursor on construction, and releases it on destruction.
+// A new reader starts from the latest element, it doesn't see what has been written before it joined.
+template <typename T, std::size_t Capacity, std::size_t MaxReaders = sMaxBroadcastReaders>
+class BroadcastReader
+{
+	static constexpr std::uint64_t sMask = Capacity - 1;
+
+public:
+	BroadcastReader(const BroadcastData<T, Capacity>* data_ptr, BroadcastCursor* cursors_ptr) :
+		m_data(data_ptr)
+	{
+		assert(m_data != nullptr);
+		assert(cursors_ptr != nullptr);
+
+		for (std::size_t i=0; i<MaxReaders; ++i)
+		{
+			std::uint32_t expected = BroadcastCursor::Free;
+			if (cursors_ptr[i].state.compare_exchange_strong(expected, BroadcastCursor::Joining, std::memory_order_acq_rel))
+			{
+				m_cursor = &cursors_ptr[i];
+				break;
+			}
+		}
+		if (m_cursor == nullptr)
+			throw std::runtime_error("Error: BroadcastReader no free cursor");
+
+		// publish a conservative position first, then activate, then move to the latest head.
+		// Any scan of writer after activation sees this cursor, and any element writer wrote before that is
+		// older than the head we read afterwards.
+		m_cursor->pos.store(m_data->head.load(std::memory_order_acquire), std::memory_order_relaxed);
+		m_cursor->state.store(BroadcastCursor::Active, std::memory_order_release);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		m_pos = m_data->head.load(std::memory_order_acquire);
+		m_cached_head = m_pos;
+		m_cursor->pos.store(m_pos, std::memory_order_release);
+	}
+
+	~BroadcastReader()
+	{
+		unregister();
+	}
+
+	// release the cursor so writer stops waiting for us, safe to call more than once
+	void unregister()
+	{
+		if (m_cursor != nullptr)
+		{
+			m_cursor->state.store(BroadcastCursor::Free, std::memory_order_release);
+			m_cursor = nullptr;
+		}
+	}
+
+	// Return false if there is no new element
+	bool get(T& rdata)
+	{
+		assert(m_cursor != nullptr);
+
+		if (m_pos == m_cached_head)
+		{
+			m_cached_head = m_data->head.load(std::memory_order_acquire);
+			if (m_pos == m_cached_head)
+				return false;
+		}
+
+		rdata = m_data->elems[m_pos & sMask];
+		++m_pos;
+		// let writer reuse the slot
+		m_cursor->pos.store(m_pos, std::memory_order_release);
+		return true;
+	}
+
+private:
+	// disable copy-construct, and assignment operator
+	BroadcastReader(const BroadcastReader&);
+	BroadcastReader(BroadcastReader&&);
+	BroadcastReader& operator=(BroadcastReader&);
+	BroadcastReader& operator=(BroadcastReader&&);
+
+private:
+	const BroadcastData<T, Capacity>* m_data = nullptr;
+	BroadcastCursor* m_cursor = nullptr;
+
+	// process-local copy of our cursor, and of head as of the last load
+	std::uint64_t m_pos = 0;
+	std::uint64_t m_cached_head = 0;
+};
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <span>
+
+#include "lib.h"
+
+using namespace lib;
+
+// Single-producer single-consumer ring of variable-length records over raw bytes.
+//
+// Each record is an 8-byte header (payload length, and type) followed by the payload, padded so the next record
+// starts 8-byte aligned. A record never wraps around, when it doesn't fit before the end of buffer producer fills
+// the rest with a padding record which consumer skips. Producer reserves exactly the bytes it needs, so small
+// messages take a few words instead of a whole fixed-size slot, and the only size limit is the ring itself.
+//
+// Offsets only grow and never wrap, position in buffer is derived by masking.
+template <std::size_t Capacity>
+class ByteRingBuffer
+{
+	static_assert(Capacity >= 16 && (Capacity & (Capacity - 1)) == 0, "Capacity must be power of two");
+
+	static constexpr std::uint64_t sMask = Capacity - 1;
+
+	struct RecordHeader
+	{
+		std::uint32_t length;
+		std::uint32_t type;
+	};
+
+	enum RecordType : std::uint32_t
+	{
+		Data = 1,
+		Padding
+	};
+
+	static constexpr std::size_t sAlignment = 8;
+	static_assert(sizeof(RecordHeader) == sAlignment);
+
+	static constexpr std::size_t recordSize(std::size_t length)
+	{
+		return (sizeof(RecordHeader) + length + sAlignment - 1) & ~(sAlignment - 1);
+	}
+
+public:
+	// largest payload a single record can carry
+	static constexpr std::size_t sMaxLength = Capacity - sizeof(RecordHeader);
+
+	ByteRingBuffer(std::byte* buffer_ptr, ByteRingCtrlFields* ctrl_ptr) :
+		m_buffer(buffer_ptr),
+		m_ctrl(ctrl_ptr)
+	{
+		assert(m_buffer != nullptr);
+		assert(m_ctrl != nullptr);
+
+		m_cached_head = m_ctrl->head.load(std::memory_order_acquire);
+		m_cached_tail = m_ctrl->tail.load(std::memory_order_acquire);
+	}
+
+	// Reserve a record of exactly 'length' bytes and return its payload to be filled in place, then publish with
+	// commit(). Return span with null data() if there is not enough free space yet (a zero-length record still
+	// gets a non-null one).
+	std::span<std::byte> reserve(std::size_t length)
+	{
+		assert(m_reserved == 0);
+		assert(length <= sMaxLength);
+
+		// only producer modifies head
+		std::uint64_t head = m_ctrl->head.load(std::memory_order_relaxed);
+		const std::size_t size = recordSize(length);
+
+		const std::size_t contiguous = Capacity - (head & sMask);
+		if (size > contiguous)
+		{
+			// not enough room before the end of buffer, pad it out so the record starts over at the beginning.
+			// Padding is published on its own, so it gets consumed even if the record itself doesn't fit yet.
+			if (!_hasFree(head, contiguous))
+				return {};
+
+			_writeHeader(head, { static_cast<std::uint32_t>(contiguous - sizeof(RecordHeader)), Padding });
+			head += contiguous;
+			m_ctrl->head.store(head, std::memory_order_release);
+		}
+
+		if (!_hasFree(head, size))
+			return {};
+
+		_writeHeader(head, { static_cast<std::uint32_t>(length), Data });
+		m_reserved = size;
+		return std::span<std::byte>(m_buffer + (head & sMask) + sizeof(RecordHeader), length);
+	}
+
+	// Publish the reserved record
+	void commit()
+	{
+		assert(m_reserved != 0);
+
+		const std::uint64_t head = m_ctrl->head.load(std::memory_order_relaxed);
+		m_ctrl->head.store(head + m_reserved, std::memory_order_release);
+		m_reserved = 0;
+	}
+
+	// Copy 'msg' as a single record. Return false if there is not enough free space yet.
+	bool tryWrite(std::span<const std::byte> msg)
+	{
+		std::span<std::byte> payload = reserve(msg.size());
+		if (payload.data() == nullptr)
+			return false;
+
+		std::copy(msg.begin(), msg.end(), payload.begin());
+		commit();
+		return true;
+	}
+
+	// Return payload of the next record in place, span with null data() if there is none. It stays untouched by
+	// producer until release().
+	std::span<const std::byte> peek()
+	{
+		assert(m_peeked == 0);
+
+		// only consumer modifies tail
+		std::uint64_t tail = m_ctrl->tail.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			if (tail == m_cached_head)
+			{
+				m_cached_head = m_ctrl->head.load(std::memory_order_acquire);
+				if (tail == m_cached_head)
+					return {};
+			}
+
+			const RecordHeader header = _readHeader(tail);
+			if (header.type == Padding)
+			{
+				// skip to the beginning of buffer, and let producer reuse the padded bytes right away
+				tail += sizeof(RecordHeader) + header.length;
+				m_ctrl->tail.store(tail, std::memory_order_release);
+				continue;
+			}
+
+			m_peeked = recordSize(header.length);
+			return std::span<const std::byte>(m_buffer + (tail & sMask) + sizeof(RecordHeader), header.length);
+		}
+	}
+
+	// Hand the peeked record back to producer
+	void release()
+	{
+		assert(m_peeked != 0);
+
+		const std::uint64_t tail = m_ctrl->tail.load(std::memory_order_relaxed);
+		m_ctrl->tail.store(tail + m_peeked, std::memory_order_release);
+		m_peeked = 0;
+	}
+
+private:
+	bool _hasFree(std::uint64_t head, std::size_t size)
+	{
+		if (Capacity - (head - m_cached_tail) >= size)
+			return true;
+
+		m_cached_tail = m_ctrl->tail.load(std::memory_order_acquire);
+		return Capacity - (head - m_cached_tail) >= size;
+	}
+
+	// header is copied as bytes, as buffer is just raw storage
+	void _writeHeader(std::uint64_t pos, RecordHeader header)
+	{
+		std::memcpy(m_buffer + (pos & sMask), &header, sizeof(header));
+	}
+
+	RecordHeader _readHeader(std::uint64_t pos) const
+	{
+		RecordHeader header;
+		std::memcpy(&header, m_buffer + (pos & sMask), sizeof(header));
+		return header;
+	}
+
+	// disable copy-construct, and assignment operator
+	ByteRingBuffer(const ByteRingBuffer&);
+	ByteRingBuffer(ByteRingBuffer&&);
+	ByteRingBuffer& operator=(ByteRingBuffer&);
+	ByteRingBuffer& operator=(ByteRingBuffer&&);
+
+private:
+	std::byte* m_buffer = nullptr;
+	ByteRingCtrlFields* m_ctrl = nullptr;
+
+	// process-local view of the other side's offset
+	std::uint64_t m_cached_head = 0;
+	std::uint64_t m_cached_tail = 0;
+
+	// size of the record handed out by reserve() (or peek()) which isn't committed (or released) yet
+	std::size_t m_reserved = 0;
+	std::size_t m_peeked = 0;
+};
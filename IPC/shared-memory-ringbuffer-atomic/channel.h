@@ -0,0 +1,288 @@
+#pragma once
+
+#include <atomic>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "lib.h"
+#include "ringbuffer.h"
+
+// Many named rings in a single shared memory segment.
+//
+// Segment starts with ChannelDirectoryHeader, a fixed table of channels, followed by the rings themselves:
+//
+//   [ChannelDirectoryHeader | entries ...][ctrl | elements | sequences][ctrl | elements | sequences] ...
+//                                         ^ channel "a"                ^ channel "b"
+//
+// A channel is created by claiming a free entry, allocating its ring by bumping 'used', filling in the entry and
+// marking it ready last, so whoever finds it by name sees the rest of it as well. Channels are never removed.
+// One process maps one segment for all of its feeds, instead of a segment per feed.
+namespace lib
+{
+
+// "OSIMCHN1"
+const std::uint64_t sChannelMagic = 0x314e48434d49534full;
+// bump whenever layout of ChannelDirectoryHeader, ChannelEntry or of the rings changes
+const std::uint32_t sChannelLayoutVersion = 4;
+
+const char* const sDefaultChannelSegmentName = "/osimhen-channels";
+
+inline std::size_t alignCacheLine(std::size_t n)
+{
+	return (n + 63) & ~std::size_t(63);
+}
+
+// Bytes taken by the ring of a channel of 'capacity' elements
+inline std::size_t channelRingSize(std::size_t capacity)
+{
+	return sizeof(RingBufferCtrlFields) + alignCacheLine(capacity * sizeof(ElementData)) + alignCacheLine(capacity * sizeof(std::atomic<std::uint64_t>));
+}
+
+// Size of a segment with room for 'channels' channels of 'capacity' elements
+inline std::size_t channelSegmentSize(std::size_t channels, std::size_t capacity)
+{
+	return alignCacheLine(sizeof(ChannelDirectoryHeader)) + channels * channelRingSize(capacity);
+}
+
+class ChannelDirectory
+{
+public:
+	ChannelDirectory(void* ptr, std::size_t size) :
+		m_base(static_cast<std::byte*>(ptr)),
+		m_size(size)
+	{
+		assert(m_base != nullptr);
+	}
+
+	ChannelDirectoryHeader* header() const
+	{
+		return reinterpret_cast<ChannelDirectoryHeader*>(m_base);
+	}
+
+	// Creator only, on a freshly sized segment before anyone attaches
+	void init()
+	{
+		ChannelDirectoryHeader* h = header();
+		h->version = sChannelLayoutVersion;
+		h->element_size = sizeof(ElementData);
+		h->segment_size = m_size;
+		h->used.store(alignCacheLine(sizeof(ChannelDirectoryHeader)), std::memory_order_relaxed);
+
+		// last, so whoever sees the magic sees the rest of header as well
+		h->magic.store(sChannelMagic, std::memory_order_release);
+	}
+
+	// Return why the segment can't be used, or nullptr if it's fine
+	const char* check() const
+	{
+		const ChannelDirectoryHeader* h = header();
+		if (m_size < sizeof(ChannelDirectoryHeader))
+			return "segment is too small to be a channel segment";
+		if (h->magic.load(std::memory_order_acquire) != sChannelMagic)
+			return "not a channel segment, or writer hasn't initialized it yet";
+		if (h->version != sChannelLayoutVersion)
+			return "layout version differs from this binary";
+		if (h->element_size != sizeof(ElementData))
+			return "element size differs from this binary";
+		if (h->segment_size > m_size)
+			return "segment is smaller than its header says";
+		return nullptr;
+	}
+
+	// Return nullptr if 'name' is empty, too long or taken, if there is no free entry, or no room for the ring.
+	// Only one process is meant to create channels, others only find them.
+	ChannelEntry* create(std::string_view name, std::size_t capacity)
+	{
+		if (name.empty() || name.size() >= sChannelNameSize || find(name) != nullptr)
+			return nullptr;
+		if (capacity < 2 || (capacity & (capacity - 1)) != 0 || capacity > (1u << 30))
+			return nullptr;
+
+		ChannelDirectoryHeader* h = header();
+		ChannelEntry* entry = nullptr;
+		for (ChannelEntry& e : h->entries)
+		{
+			std::uint32_t expected = ChannelEntry::Free;
+			if (e.state.compare_exchange_strong(expected, ChannelEntry::Creating, std::memory_order_acq_rel))
+			{
+				entry = &e;
+				break;
+			}
+		}
+		if (entry == nullptr)
+			return nullptr;
+
+		const std::size_t ring_size = channelRingSize(capacity);
+		std::uint64_t offset = h->used.load(std::memory_order_relaxed);
+		do
+		{
+			if (offset + ring_size > h->segment_size)
+			{
+				entry->state.store(ChannelEntry::Free, std::memory_order_release);
+				return nullptr;
+			}
+		}
+		while (!h->used.compare_exchange_weak(offset, offset + ring_size, std::memory_order_relaxed));
+
+		// ring of a fresh segment is zero-filled, which is an empty ring
+		std::memcpy(entry->name, name.data(), name.size());
+		entry->name[name.size()] = '\0';
+		entry->capacity = capacity;
+		entry->ctrl_offset = offset;
+		entry->data_offset = offset + sizeof(RingBufferCtrlFields);
+		entry->seq_offset = entry->data_offset + alignCacheLine(capacity * sizeof(ElementData));
+
+		entry->state.store(ChannelEntry::Ready, std::memory_order_release);
+		return entry;
+	}
+
+	// Return nullptr if there is no such channel (yet)
+	ChannelEntry* find(std::string_view name) const
+	{
+		for (ChannelEntry& e : header()->entries)
+		{
+			if (e.state.load(std::memory_order_acquire) == ChannelEntry::Ready && name == e.name)
+				return &e;
+		}
+		return nullptr;
+	}
+
+	// All ready channels, in order of creation
+	std::vector<ChannelEntry*> channels() const
+	{
+		std::vector<ChannelEntry*> result;
+		for (ChannelEntry& e : header()->entries)
+		{
+			if (e.state.load(std::memory_order_acquire) == ChannelEntry::Ready)
+				result.push_back(&e);
+		}
+		return result;
+	}
+
+	// Return why the ring of 'entry' can't be used, or nullptr if it's fine. Entries are taken from the segment as they
+	// are, so a corrupt or foreign one mustn't make a ring point outside of the mapping.
+	const char* checkEntry(const ChannelEntry& entry) const
+	{
+		const std::uint64_t capacity = entry.capacity;
+		if (capacity < 2 || (capacity & (capacity - 1)) != 0 || capacity > (1u << 30))
+			return "channel capacity is not a power of two up to 2^30";
+		if (entry.ctrl_offset % 64 != 0 || entry.data_offset != entry.ctrl_offset + sizeof(RingBufferCtrlFields)
+			|| entry.seq_offset != entry.data_offset + alignCacheLine(capacity * sizeof(ElementData)))
+			return "channel ring is laid out differently from this binary";
+		if (entry.ctrl_offset < alignCacheLine(sizeof(ChannelDirectoryHeader)) || entry.ctrl_offset > m_size
+			|| channelRingSize(capacity) > m_size - entry.ctrl_offset)
+			return "channel ring lies outside of the mapped segment";
+		return nullptr;
+	}
+
+	// Ring of 'entry', either side of it. Return nullptr if checkEntry() finds it can't be used.
+	template <FullPolicy Policy = FullPolicy::Block>
+	std::unique_ptr<PolicyRingBuffer<Policy>> ring(const ChannelEntry& entry) const
+	{
+		if (checkEntry(entry) != nullptr)
+			return nullptr;
+
+		return std::make_unique<PolicyRingBuffer<Policy>>(
+			reinterpret_cast<ElementData*>(m_base + entry.data_offset),
+			reinterpret_cast<std::atomic<std::uint64_t>*>(m_base + entry.seq_offset),
+			entry.capacity,
+			reinterpret_cast<RingBufferCtrlFields*>(m_base + entry.ctrl_offset));
+	}
+
+private:
+	std::byte* m_base = nullptr;
+	std::size_t m_size = 0;
+};
+
+// Order in which ChannelPoller services its channels
+enum class ChannelScheduling
+{
+	// every channel gets up to a batch per poll, first one to be serviced rotates
+	RoundRobin,
+	// channels added earlier come first, a channel is only serviced when all earlier ones are empty
+	// so a busy channel can starve the ones after it
+	Priority
+};
+
+// Consumer of many channels from a single polling loop, elements are handed to the caller in place
+class ChannelPoller
+{
+public:
+	ChannelPoller(ChannelScheduling scheduling, std::size_t batch) :
+		m_scheduling(scheduling),
+		m_batch(std::max<std::size_t>(batch, 1))
+	{
+	}
+
+	void add(std::string_view name, std::unique_ptr<RingBuffer> ring)
+	{
+		m_channels.push_back({ std::string(name), std::move(ring) });
+	}
+
+	std::size_t size() const
+	{
+		return m_channels.size();
+	}
+
+	// Call handler(name, const ElementData&) for what's available, up to a batch per channel.
+	// Return number of elements handled, 0 means all channels were empty.
+	template <typename F>
+	std::size_t poll(F&& handler)
+	{
+		const std::size_t n = m_channels.size();
+		std::size_t handled = 0;
+
+		if (m_scheduling == ChannelScheduling::Priority)
+		{
+			for (Channel& channel : m_channels)
+			{
+				handled = _service(channel, handler);
+				if (handled != 0)
+					break;
+			}
+			return handled;
+		}
+
+		for (std::size_t i=0; i<n; ++i)
+			handled += _service(m_channels[(m_next + i) % n], handler);
+		if (n != 0)
+			m_next = (m_next + 1) % n;
+		return handled;
+	}
+
+private:
+	struct Channel
+	{
+		std::string name;
+		std::unique_ptr<RingBuffer> ring;
+	};
+
+	template <typename F>
+	std::size_t _service(Channel& channel, F& handler)
+	{
+		SlotSpans<const ElementData> spans = channel.ring->peek(m_batch);
+		for (const ElementData& elem : spans.first)
+			handler(std::string_view(channel.name), elem);
+		for (const ElementData& elem : spans.second)
+			handler(std::string_view(channel.name), elem);
+
+		// one store of tail for the whole batch
+		channel.ring->release(spans.size());
+		return spans.size();
+	}
+
+	ChannelScheduling m_scheduling;
+	std::size_t m_batch;
+	std::vector<Channel> m_channels;
+	// where round robin starts next time
+	std::size_t m_next = 0;
+};
+
+};
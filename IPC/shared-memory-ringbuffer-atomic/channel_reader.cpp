@@ -0,0 +1,148 @@
+/**
+ * Reader of many channels from a single polling loop, see channel.h.
+ * It finds the channels by name in the segment created by 'channel-writer', and services them in round robin or
+ * by priority. When all of them are empty it backs off, first yielding then sleeping, as it can't block on more
+ * than one ring at once.
+ * It will automatically break out from the loop if the writer process has terminated via checking 'operational' flag.
+ *
+ * Usage: ./channel-reader [--name /name] [--priority] [--batch N] [CHANNEL...]
+ * --name is the segment writer created (default /osimhen-channels). Without channels given, all of them are read.
+ * --priority services channels in the order given, a channel only when all before it are empty, otherwise
+ * it's round robin. --batch is the most elements taken from a channel at once (default 16).
+ */
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <csignal>
+#include <thread>
+#include <chrono>
+#include <string_view>
+#include <vector>
+
+#include "lib.h"
+#include "ringbuffer.h"
+#include "segment.h"
+#include "channel.h"
+
+using namespace lib;
+
+ShmFdClient* s_shm_fd_obj = nullptr;
+MMap* s_mmap = nullptr;
+
+// number of empty polls to only yield for, before sleeping
+const int sIdleYields = 100;
+
+// shared memory won't be unlinked automatically and it still exists on the machine if signal comes
+// so we handle them here.
+void signal_handler(int signal)
+{
+	// just make a copy
+	if (s_shm_fd_obj != nullptr)
+		ShmFdClient stack_value = *s_shm_fd_obj;
+
+	if (s_mmap != nullptr)
+		MMap stack_value2 = *s_mmap;
+
+	// force exit to avoid double destructor call otherwise it will return back to normal flow within main()
+	std::exit(1);
+}
+
+int main(int argc, char* argv[])
+{
+	std::signal(SIGINT, signal_handler);
+	std::signal(SIGTERM, signal_handler);
+
+	const char* name = sDefaultChannelSegmentName;
+	ChannelScheduling scheduling = ChannelScheduling::RoundRobin;
+	std::size_t batch = 16;
+	std::vector<std::string_view> channel_names;
+	for (int i=1; i<argc; ++i)
+	{
+		const std::string_view arg(argv[i]);
+		if (arg == "--priority")
+			scheduling = ChannelScheduling::Priority;
+		else if (arg == "--name" && i + 1 < argc)
+			name = argv[++i];
+		else if (arg == "--batch" && i + 1 < argc)
+			batch = std::strtoull(argv[++i], nullptr, 10);
+		else if (!arg.starts_with("--"))
+			channel_names.push_back(arg);
+		else
+		{
+			std::cerr << "Usage: " << argv[0] << " [--name /name] [--priority] [--batch N] [CHANNEL...]\n";
+			return 1;
+		}
+	}
+
+	Segment segment;
+	if (!attachSegment(name, MapOptions{}, segment))
+		return 1;
+
+	// for RAII
+	ShmFdClient shm_fd_obj(segment.fd, name);
+	s_shm_fd_obj = &shm_fd_obj;
+
+	// for RAII
+	MMap mmap(segment.ptr, segment.size);
+	s_mmap = &mmap;
+
+	ChannelDirectory dir(segment.ptr, segment.size);
+	if (const char* reason = dir.check())
+	{
+		std::cerr << "segment " << name << " can't be used: " << reason << "\n";
+		return 1;
+	}
+
+	std::vector<ChannelEntry*> entries;
+	if (channel_names.empty())
+		entries = dir.channels();
+	else
+	{
+		for (std::string_view channel_name : channel_names)
+		{
+			ChannelEntry* entry = dir.find(channel_name);
+			if (entry == nullptr)
+			{
+				std::cerr << "no channel " << channel_name << " in " << name << "\n";
+				return 1;
+			}
+			entries.push_back(entry);
+		}
+	}
+
+	ChannelPoller poller(scheduling, batch);
+	for (ChannelEntry* entry : entries)
+	{
+		if (const char* reason = dir.checkEntry(*entry))
+		{
+			std::cerr << "channel " << entry->name << " in " << name << " can't be used: " << reason << "\n";
+			return 1;
+		}
+		poller.add(entry->name, dir.ring(*entry));
+	}
+
+	bool operational = true;
+	int idle = 0;
+	while (operational)
+	{
+		const std::size_t handled = poller.poll([](std::string_view channel, const ElementData& elem) {
+			std::cout << "[" << channel << "] " << elem << std::endl;
+		});
+
+		if (handled != 0)
+		{
+			idle = 0;
+			continue;
+		}
+
+		operational = dir.header()->operational.load(std::memory_order_acquire);
+		if (++idle < sIdleYields)
+			sched_yield();
+		else
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	return 0;
+}
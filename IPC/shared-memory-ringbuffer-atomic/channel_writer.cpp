@@ -0,0 +1,163 @@
+/**
+ * Writer of many channels in a single shared memory segment, see channel.h.
+ * It creates the segment with a channel for each name given, then keeps writing into them, channel i getting
+ * an element every (i + 1)th iteration so they go at different rates.
+ * User can quit the writer process by pressing Ctrl+C then it will clear resource as well as setting
+ * 'operational' of the directory to notify readers that it has terminated.
+ *
+ * Usage: ./channel-writer [--name /name] [--capacity N] [--hugepages] [--prefault] CHANNEL...
+ * --name is the segment to create (default /osimhen-channels), --capacity the number of elements of each channel
+ * (power of two, default 512). A channel which is full drops new elements instead of holding back the others.
+ */
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstring>
+#include <thread>
+#include <string_view>
+#include <csignal>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "lib.h"
+#include "ringbuffer.h"
+#include "segment.h"
+#include "channel.h"
+
+using namespace lib;
+
+static bool s_still_operate = true;
+
+ShmFd* s_shm_fd_obj = nullptr;
+MMap* s_mmap = nullptr;
+ChannelDirectoryHeader* s_header = nullptr;
+
+// shared memory won't be unlinked automatically and it still exists on the machine if signal comes
+// so we handle them here.
+void signal_handler(int signal)
+{
+	s_still_operate = false;
+
+	// to signal readers that writer process has down
+	if (s_header != nullptr)
+		s_header->operational.store(false, std::memory_order_release);
+
+	// just make a copy
+	if (s_shm_fd_obj != nullptr)
+		ShmFd stack_value = *s_shm_fd_obj;
+
+	if (s_mmap != nullptr)
+		MMap stack_value2 = *s_mmap;
+
+	// force exit to avoid double destructor call otherwise it will return back to normal flow within main()
+	std::exit(1);
+}
+
+int main(int argc, char* argv[])
+{
+	std::signal(SIGINT, signal_handler);
+	std::signal(SIGTERM, signal_handler);
+
+	// random for ms to delay each iteration of writing into shared memory
+	std::random_device rd;
+	std::mt19937 gen(rd());
+	std::uniform_int_distribution<> dis(20, 40);
+
+	const char* name = sDefaultChannelSegmentName;
+	std::size_t capacity = sElementSize;
+	MapOptions map_opts;
+	std::vector<std::string_view> channel_names;
+	for (int i=1; i<argc; ++i)
+	{
+		const std::string_view arg(argv[i]);
+		if (arg == "--hugepages")
+			map_opts.hugepages = true;
+		else if (arg == "--prefault")
+			map_opts.prefault = true;
+		else if (arg == "--name" && i + 1 < argc)
+			name = argv[++i];
+		else if (arg == "--capacity" && i + 1 < argc)
+			capacity = std::strtoull(argv[++i], nullptr, 10);
+		else if (!arg.starts_with("--"))
+			channel_names.push_back(arg);
+		else
+		{
+			channel_names.clear();
+			break;
+		}
+	}
+
+	if (channel_names.empty() || channel_names.size() > static_cast<std::size_t>(sMaxChannels))
+	{
+		std::cerr << "Usage: " << argv[0] << " [--name /name] [--capacity N] [--hugepages] [--prefault] CHANNEL...\n";
+		std::cerr << "up to " << sMaxChannels << " channels\n";
+		return 1;
+	}
+
+	if (capacity < 2 || (capacity & (capacity - 1)) != 0 || capacity > (1u << 30))
+	{
+		std::cerr << "capacity must be power of two, up to 2^30\n";
+		return 1;
+	}
+
+	Segment segment;
+	if (!createSegment(name, channelSegmentSize(channel_names.size(), capacity), map_opts, segment))
+		return 1;
+
+	// for RAII obj
+	const bool is_file = !segment.file_path.empty();
+	ShmFd shm_fd_obj(segment.fd, is_file ? std::string_view(segment.file_path) : std::string_view(name), is_file);
+	s_shm_fd_obj = &shm_fd_obj;
+
+	// for RAII obj
+	MMap mmap(segment.ptr, segment.size);
+	s_mmap = &mmap;
+
+	ChannelDirectory dir(segment.ptr, segment.size);
+	dir.init();
+	s_header = dir.header();
+
+	// a slow reader of one channel shouldn't stall the others, so drop instead of waiting
+	std::vector<std::unique_ptr<PolicyRingBuffer<FullPolicy::DropNewest>>> rings;
+	for (std::string_view channel_name : channel_names)
+	{
+		ChannelEntry* entry = dir.create(channel_name, capacity);
+		if (entry == nullptr)
+		{
+			std::cerr << "can't create channel " << channel_name << ", name too long or given twice?\n";
+			return 1;
+		}
+		rings.push_back(dir.ring<FullPolicy::DropNewest>(*entry));
+	}
+
+	s_header->operational.store(true, std::memory_order_release);
+
+	int increment_id = 0;
+	while (s_still_operate)
+	{
+		for (std::size_t i=0; i<rings.size(); ++i)
+		{
+			if (increment_id % (i + 1) != 0)
+				continue;
+
+			// prepare ElementData straight in the slot of shared memory, then publish it
+			ElementData* elem_data = rings[i]->claim();
+			elem_data->id = increment_id;
+			std::snprintf(elem_data->name, sizeof(elem_data->name), "hello from %.*s", static_cast<int>(channel_names[i].size()), channel_names[i].data());
+			elem_data->sent_ns = steadyNowNs();
+			rings[i]->commit();
+		}
+		++increment_id;
+
+		// random delay time in ms
+		int delay_ms = dis(gen);
+		std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
+	}
+
+	return 0;
+}
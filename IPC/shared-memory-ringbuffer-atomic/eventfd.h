@@ -0,0 +1,219 @@
+#pragma once
+
+#include <iostream>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <atomic>
+#include <thread>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/eventfd.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Readiness notification of a ring through an eventfd, so consumer can wait for it with epoll/poll/select together
+// with its sockets, timers and whatever else.
+//
+// Producer creates the eventfd and hands it out over a Unix socket (SCM_RIGHTS) to consumers which connect to it.
+// The socket is served from a thread of its own, as producer itself may be blocked on a full ring for as long as no
+// consumer shows up.
+// It only writes to the eventfd when consumer has said it's going to sleep, so a busy ring costs no syscall,
+// see BasicRingBuffer::prepareSleep().
+namespace lib
+{
+
+inline int createEventFd()
+{
+	return eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+}
+
+inline void signalEventFd(int fd)
+{
+	const std::uint64_t one = 1;
+	// can only fail if counter is about to overflow, and then it's signaled already
+	[[maybe_unused]] ssize_t res = write(fd, &one, sizeof(one));
+}
+
+// reading resets the counter, non-blocking so it's fine if nothing was signaled
+inline void drainEventFd(int fd)
+{
+	std::uint64_t value;
+	[[maybe_unused]] ssize_t res = read(fd, &value, sizeof(value));
+}
+
+// closes fd on destruction
+struct UniqueFd
+{
+	explicit UniqueFd(int fd = -1) :
+		m_fd(fd)
+	{}
+
+	~UniqueFd()
+	{
+		if (m_fd != -1)
+			close(m_fd);
+	}
+
+	int get() const
+	{
+		return m_fd;
+	}
+
+private:
+	// disable copy-construct, and assignment operator
+	UniqueFd(const UniqueFd&);
+	UniqueFd& operator=(const UniqueFd&);
+
+	int m_fd = -1;
+};
+
+// Socket of ring 'name' in abstract namespace, so there is no file to clean up after
+inline socklen_t notifySocketAddr(std::string_view name, sockaddr_un& addr)
+{
+	const std::string path = std::string("osimhen-notify") + std::string(name);
+
+	std::memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	// sun_path[0] stays '\0' for abstract namespace
+	const std::size_t len = std::min(path.size(), sizeof(addr.sun_path) - 1);
+	std::memcpy(addr.sun_path + 1, path.data(), len);
+	return static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + 1 + len);
+}
+
+// how long consumer waits for producer to hand the eventfd over
+const int sEventFdTimeoutMs = 2000;
+// how often the serving thread checks whether it should stop
+const int sEventFdServePollMs = 100;
+
+// Producer side, hands 'event_fd' to every consumer connecting to the socket of ring 'name' from a thread of its own
+class EventFdServer
+{
+public:
+	EventFdServer(std::string_view name, int event_fd) :
+		m_event_fd(event_fd)
+	{
+		m_sock = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		if (m_sock == -1)
+			throw std::runtime_error("Error: EventFdServer socket() failed");
+
+		sockaddr_un addr;
+		const socklen_t len = notifySocketAddr(name, addr);
+		if (bind(m_sock, reinterpret_cast<sockaddr*>(&addr), len) != 0 || listen(m_sock, 16) != 0)
+		{
+			close(m_sock);
+			throw std::runtime_error("Error: EventFdServer bind() or listen() failed, is another writer running?");
+		}
+
+		// signals stay with producer's own thread, the serving one starts with all of them blocked
+		sigset_t all;
+		sigset_t old;
+		sigfillset(&all);
+		pthread_sigmask(SIG_BLOCK, &all, &old);
+		m_thread = std::thread([this]() { _run(); });
+		pthread_sigmask(SIG_SETMASK, &old, nullptr);
+	}
+
+	~EventFdServer()
+	{
+		m_stop.store(true, std::memory_order_relaxed);
+		m_thread.join();
+		close(m_sock);
+	}
+
+private:
+	void _run()
+	{
+		pollfd pfd = { m_sock, POLLIN, 0 };
+		while (!m_stop.load(std::memory_order_relaxed))
+		{
+			if (poll(&pfd, 1, sEventFdServePollMs) > 0)
+				_serve();
+		}
+	}
+
+	// Non-blocking, serve whoever is waiting to connect
+	void _serve()
+	{
+		int conn;
+		while ((conn = accept4(m_sock, nullptr, nullptr, SOCK_CLOEXEC)) != -1)
+		{
+			char byte = 0;
+			iovec iov = { &byte, 1 };
+
+			alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+			msghdr msg = {};
+			msg.msg_iov = &iov;
+			msg.msg_iovlen = 1;
+			msg.msg_control = control;
+			msg.msg_controllen = sizeof(control);
+
+			cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+			cmsg->cmsg_level = SOL_SOCKET;
+			cmsg->cmsg_type = SCM_RIGHTS;
+			cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+			std::memcpy(CMSG_DATA(cmsg), &m_event_fd, sizeof(int));
+
+			if (sendmsg(conn, &msg, MSG_NOSIGNAL) == -1)
+				std::cerr << "sendmsg() of eventfd failed\n";
+			close(conn);
+		}
+	}
+
+	// disable copy-construct, and assignment operator
+	EventFdServer(const EventFdServer&);
+	EventFdServer& operator=(const EventFdServer&);
+
+	int m_sock = -1;
+	int m_event_fd = -1;
+	std::atomic<bool> m_stop{false};
+	std::thread m_thread;
+};
+
+// Consumer side, return the eventfd producer of ring 'name' hands out, -1 on failure or after sEventFdTimeoutMs
+inline int receiveEventFd(std::string_view name)
+{
+	UniqueFd sock(socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0));
+	if (sock.get() == -1)
+		return -1;
+
+	// connect() of a Unix socket waits on a full backlog for as long as the send timeout
+	const timeval timeout = { sEventFdTimeoutMs / 1000, (sEventFdTimeoutMs % 1000) * 1000 };
+	if (setsockopt(sock.get(), SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) != 0
+		|| setsockopt(sock.get(), SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) != 0)
+		return -1;
+
+	sockaddr_un addr;
+	const socklen_t len = notifySocketAddr(name, addr);
+	if (connect(sock.get(), reinterpret_cast<sockaddr*>(&addr), len) != 0)
+		return -1;
+
+	char byte;
+	iovec iov = { &byte, 1 };
+
+	alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+	msghdr msg = {};
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	if (recvmsg(sock.get(), &msg, MSG_CMSG_CLOEXEC) != 1)
+		return -1;
+
+	cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+	if (cmsg == nullptr || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+		return -1;
+
+	int fd;
+	std::memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+	return fd;
+}
+
+};
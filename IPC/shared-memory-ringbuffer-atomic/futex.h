@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "lib.h"
+
+namespace lib
+{
+
+static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t) && std::atomic<std::uint32_t>::is_always_lock_free,
+	"futex requires std::atomic<uint32_t> to be a plain 32-bit word");
+
+// number of spins with CPU pause before parking on futex
+const int sSpinCount = 200;
+
+inline void cpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	asm volatile("yield" ::: "memory");
+#endif
+}
+
+// not FUTEX_PRIVATE_FLAG as the word lives in shared memory across processes
+inline long futexWait(std::atomic<std::uint32_t>* addr, std::uint32_t expected, const timespec* timeout)
+{
+	return syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(addr), FUTEX_WAIT, expected, timeout, nullptr, 0);
+}
+
+inline long futexWake(std::atomic<std::uint32_t>* addr, int count)
+{
+	return syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(addr), FUTEX_WAKE, count, nullptr, nullptr, 0);
+}
+
+// Hybrid wait until 'ready()' returns true, or timeout has passed.
+// Spin briefly with CPU pause first as the counterpart is likely to be right behind, then flag ourselves as a waiter
+// and park on the futex word. Return whether 'ready()' became true.
+//
+// Pairs with notify(), and 'ready()' has to observe what the notifier published before calling notify().
+template <typename F>
+bool waitFor(FutexWaitWord* w, F&& ready, std::chrono::nanoseconds timeout = std::chrono::nanoseconds::max())
+{
+	for (int i=0; i<sSpinCount; ++i)
+	{
+		if (ready())
+			return true;
+		cpuRelax();
+	}
+
+	const bool forever = timeout == std::chrono::nanoseconds::max();
+	const auto deadline = forever ? std::chrono::steady_clock::time_point::max() : std::chrono::steady_clock::now() + timeout;
+
+	for (;;)
+	{
+		// flag before the last check, so either notifier sees us waiting or we see what it published
+		w->waiters.fetch_add(1, std::memory_order_seq_cst);
+		const std::uint32_t seq = w->seq.load(std::memory_order_seq_cst);
+
+		if (ready())
+		{
+			w->waiters.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+
+		if (forever)
+			futexWait(&w->seq, seq, nullptr);
+		else
+		{
+			const auto remaining = deadline - std::chrono::steady_clock::now();
+			if (remaining <= std::chrono::nanoseconds::zero())
+			{
+				w->waiters.fetch_sub(1, std::memory_order_relaxed);
+				return false;
+			}
+
+			const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(remaining).count();
+			timespec ts;
+			ts.tv_sec = ns / 1'000'000'000;
+			ts.tv_nsec = ns % 1'000'000'000;
+			// returns on wake-up, timeout, signal, or immediately if seq has changed since we loaded it
+			futexWait(&w->seq, seq, &ts);
+		}
+
+		w->waiters.fetch_sub(1, std::memory_order_relaxed);
+		if (ready())
+			return true;
+	}
+}
+
+// Wake up all waiters parked by waitFor(), call after publishing.
+// Only issues a syscall when there is a waiter flagged.
+inline void notify(FutexWaitWord* w)
+{
+	// order the publish before reading waiters, pairs with fetch_add in waitFor()
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (w->waiters.load(std::memory_order_relaxed) == 0)
+		return;
+
+	w->seq.fetch_add(1, std::memory_order_release);
+	futexWake(&w->seq, INT_MAX);
+}
+
+};
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#include "ringbuffer.h"
+
+// Ring in ordinary process memory, for producer and consumer threads of one process.
+//
+// BasicRingBuffer only works through pointers, it doesn't care whether they point into a shared memory segment or
+// into the heap. HeapRing owns what a segment would otherwise hold: RingBufferCtrlFields, elements and, with
+// FullPolicy::OverwriteOldest, per-slot sequences. They come from a single std::aligned_alloc(), each part on a
+// cache line boundary, zero-filled as a fresh segment is.
+//
+// Producer and consumer thread each take their own ring() over it, as with IndexCaching::Local an instance caches the
+// index of the other side. HeapRing has to outlive both.
+namespace lib
+{
+
+template <typename T, FullPolicy Policy = FullPolicy::Block>
+class HeapRing
+{
+public:
+	using Ring = BasicRingBuffer<T, sDynamicCapacity, IndexCaching::Local, Policy>;
+
+	explicit HeapRing(std::size_t capacity) :
+		m_capacity(capacity)
+	{
+		if (capacity < 2 || (capacity & (capacity - 1)) != 0)
+			throw std::runtime_error("Error: HeapRing capacity has to be power of two");
+
+		const std::size_t elems_offset = _roundUp(sizeof(RingBufferCtrlFields));
+		const std::size_t seqs_offset = _roundUp(elems_offset + capacity * sizeof(T));
+		const std::size_t seqs_size = Policy == FullPolicy::OverwriteOldest ? capacity * sizeof(std::atomic<std::uint64_t>) : 0;
+		m_size = _roundUp(seqs_offset + seqs_size);
+
+		m_memory = static_cast<std::byte*>(std::aligned_alloc(sCacheLine, m_size));
+		if (m_memory == nullptr)
+			throw std::runtime_error("Error: HeapRing can't allocate the ring");
+		std::memset(m_memory, 0, m_size);
+
+		m_ctrl = new (m_memory) RingBufferCtrlFields();
+		m_elems = reinterpret_cast<T*>(m_memory + elems_offset);
+		if (seqs_size != 0)
+			m_slot_seqs = reinterpret_cast<std::atomic<std::uint64_t>*>(m_memory + seqs_offset);
+	}
+
+	~HeapRing()
+	{
+		std::free(m_memory);
+	}
+
+	// New ring over this memory, one for producer and one for consumer
+	Ring ring()
+	{
+		if constexpr (Policy == FullPolicy::OverwriteOldest)
+			return Ring(m_elems, m_slot_seqs, m_capacity, m_ctrl);
+		else
+			return Ring(m_elems, m_capacity, m_ctrl);
+	}
+
+	std::size_t capacity() const
+	{
+		return m_capacity;
+	}
+
+	// Bytes allocated, control fields included
+	std::size_t size() const
+	{
+		return m_size;
+	}
+
+	const RingBufferCtrlFields* ctrl() const
+	{
+		return m_ctrl;
+	}
+
+private:
+	static constexpr std::size_t sCacheLine = 64;
+
+	// aligned_alloc() wants the size to be a multiple of alignment
+	static std::size_t _roundUp(std::size_t size)
+	{
+		return (size + sCacheLine - 1) & ~(sCacheLine - 1);
+	}
+
+	// disable copy-construct, and assignment operator
+	HeapRing(const HeapRing&);
+	HeapRing& operator=(const HeapRing&);
+
+	std::byte* m_memory = nullptr;
+	std::size_t m_size = 0;
+	std::size_t m_capacity = 0;
+	RingBufferCtrlFields* m_ctrl = nullptr;
+	T* m_elems = nullptr;
+	std::atomic<std::uint64_t>* m_slot_seqs = nullptr;
+};
+
+};
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <cstddef>
+#include <ostream>
+
+namespace lib
+{
+
+// HDR-style log-linear histogram of latencies in ns, process-local.
+//
+// Each power of two range is split into sSubBuckets linear buckets, so a recorded value is off by at most
+// 1/sSubBuckets (~3%) whatever its magnitude, and values below sSubBuckets are exact. Recording is a couple of
+// shifts and an increment, no allocation nor I/O, so it's fine to call for every message.
+class LatencyHistogram
+{
+	static constexpr unsigned sSubBucketBits = 5;
+	static constexpr std::uint64_t sSubBuckets = 1ull << sSubBucketBits;
+	// enough to cover whole range of uint64_t
+	static constexpr std::size_t sBuckets = (64 - sSubBucketBits + 1) * sSubBuckets;
+
+public:
+	void record(std::uint64_t value_ns)
+	{
+		++m_counts[_bucketOf(value_ns)];
+		++m_count;
+		if (value_ns > m_max)
+			m_max = value_ns;
+	}
+
+	// add all samples of 'other', as recorded by another reader
+	void merge(const LatencyHistogram& other)
+	{
+		for (std::size_t i=0; i<sBuckets; ++i)
+			m_counts[i] += other.m_counts[i];
+		m_count += other.m_count;
+		if (other.m_max > m_max)
+			m_max = other.m_max;
+	}
+
+	std::uint64_t count() const
+	{
+		return m_count;
+	}
+
+	std::uint64_t max() const
+	{
+		return m_max;
+	}
+
+	// highest value equivalent to the one at given percentile, 0 if nothing is recorded
+	std::uint64_t percentile(double p) const
+	{
+		if (m_count == 0)
+			return 0;
+
+		std::uint64_t rank = static_cast<std::uint64_t>(p / 100.0 * m_count + 0.5);
+		if (rank == 0)
+			rank = 1;
+
+		std::uint64_t seen = 0;
+		for (std::size_t i=0; i<sBuckets; ++i)
+		{
+			seen += m_counts[i];
+			if (seen >= rank)
+			{
+				const std::uint64_t upper = _highestOf(i);
+				return upper < m_max ? upper : m_max;
+			}
+		}
+		return m_max;
+	}
+
+	void print(std::ostream& os) const
+	{
+		os << "samples: " << m_count
+			<< ", p50: " << percentile(50.0) << " ns"
+			<< ", p99: " << percentile(99.0) << " ns"
+			<< ", p99.9: " << percentile(99.9) << " ns"
+			<< ", p99.99: " << percentile(99.99) << " ns"
+			<< ", max: " << m_max << " ns\n";
+	}
+
+private:
+	static std::size_t _bucketOf(std::uint64_t v)
+	{
+		if (v < sSubBuckets)
+			return v;
+
+		// v >> shift is in [sSubBuckets, 2*sSubBuckets)
+		const unsigned shift = std::bit_width(v) - 1 - sSubBucketBits;
+		return (shift + 1) * sSubBuckets + ((v >> shift) - sSubBuckets);
+	}
+
+	static std::uint64_t _highestOf(std::size_t bucket)
+	{
+		if (bucket < sSubBuckets)
+			return bucket;
+
+		const unsigned shift = bucket / sSubBuckets - 1;
+		const std::uint64_t mantissa = bucket % sSubBuckets + sSubBuckets;
+		return ((mantissa + 1) << shift) - 1;
+	}
+
+private:
+	std::uint64_t m_counts[sBuckets] = {};
+	std::uint64_t m_count = 0;
+	std::uint64_t m_max = 0;
+};
+
+};
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <bit>
+
+#include "../shared-memory-pthread-locking/seqlock.h"
+
+namespace lib
+{
+
+// Entry of LastValueCache, to be placed in shared memory. 'key' is 0 while the entry is free, id + 1 otherwise.
+template <typename T>
+struct LastValueEntry
+{
+	alignas(64) std::atomic<std::uint64_t> key;
+	SeqLocked<T> value;
+};
+
+// Conflating cache of the latest value per key, an open-addressed table in shared memory.
+//
+// Single writer updates values in place, each under its own seqlock, so readers take a consistent snapshot of any key
+// without locks and without holding writer back. A key keeps its entry once inserted, and linear probing finds it.
+// A reader which only wants the latest value per key reads it from here, instead of draining every intermediate
+// update through the ring.
+//
+// Capacity has to be power of two, and is best kept well above the number of keys so probe sequences stay short.
+template <typename T>
+class LastValueCache
+{
+public:
+	LastValueCache(LastValueEntry<T>* entries, std::size_t capacity) :
+		m_entries(entries),
+		m_mask(capacity - 1),
+		m_shift(64 - std::countr_zero(capacity))
+	{
+		assert(m_entries != nullptr);
+		assert(capacity > 1 && (capacity & (capacity - 1)) == 0);
+	}
+
+	std::size_t capacity() const
+	{
+		return m_mask + 1;
+	}
+
+	// Writer only, and only one of them. Return false if the key is new and there is no free entry left.
+	bool update(int key, const T& value)
+	{
+		const std::uint64_t stored_key = _storedKey(key);
+		for (std::size_t i=0, idx=_hash(key); i<=m_mask; ++i, idx=(idx + 1) & m_mask)
+		{
+			LastValueEntry<T>& entry = m_entries[idx];
+			const std::uint64_t k = entry.key.load(std::memory_order_relaxed);
+			if (k == stored_key)
+			{
+				entry.value.store(value);
+				return true;
+			}
+			if (k == 0)
+			{
+				// value first, so whoever finds the key finds a value as well
+				entry.value.store(value);
+				entry.key.store(stored_key, std::memory_order_release);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Consistent copy of the latest value of 'key', return false if it hasn't been written yet
+	bool load(int key, T& out) const
+	{
+		const std::uint64_t stored_key = _storedKey(key);
+		for (std::size_t i=0, idx=_hash(key); i<=m_mask; ++i, idx=(idx + 1) & m_mask)
+		{
+			const LastValueEntry<T>& entry = m_entries[idx];
+			const std::uint64_t k = entry.key.load(std::memory_order_acquire);
+			if (k == stored_key)
+			{
+				out = entry.value.load();
+				return true;
+			}
+			if (k == 0)
+				return false;
+		}
+		return false;
+	}
+
+	// Call f(key, value, version) for every key, 'version' only ever grows while a value changes, so a reader can
+	// tell which keys changed since it last looked at them. It's taken before the value, so a value updated in
+	// between shows up as changed once more the next time.
+	template <typename F>
+	void forEach(F&& f) const
+	{
+		for (std::size_t idx=0; idx<=m_mask; ++idx)
+		{
+			const LastValueEntry<T>& entry = m_entries[idx];
+			const std::uint64_t k = entry.key.load(std::memory_order_acquire);
+			if (k == 0)
+				continue;
+
+			const std::uint32_t version = entry.value.seq.load(std::memory_order_acquire);
+			f(static_cast<int>(k - 1), entry.value.load(), version);
+		}
+	}
+
+private:
+	// 0 marks a free entry
+	static std::uint64_t _storedKey(int key)
+	{
+		return static_cast<std::uint64_t>(static_cast<std::uint32_t>(key)) + 1;
+	}
+
+	// Fibonacci hashing, top bits of the product are well mixed even for sequential keys
+	std::size_t _hash(int key) const
+	{
+		return static_cast<std::size_t>((static_cast<std::uint64_t>(static_cast<std::uint32_t>(key)) * 0x9e3779b97f4a7c15ull) >> m_shift) & m_mask;
+	}
+
+	LastValueEntry<T>* m_entries = nullptr;
+	std::size_t m_mask = 0;
+	int m_shift = 0;
+};
+
+};
@@ -1,16 +1,27 @@
 #pragma once
 
 #include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #include <stdexcept>
 #include <ostream>
 #include <cassert>
 #include <mutex>
 #include <type_traits>
 #include <atomic>
+#include <cstdint>
+#include <chrono>
+#include <cstddef>
 
 namespace lib
 {
 
+// steady clock is system-wide on Linux (CLOCK_MONOTONIC), so timestamps are comparable across processes
+inline std::uint64_t steadyNowNs()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 // NOTE: byte-alignment won't make difference (even if apply where situation doesn't need it makes it worse) in case of no modification of the consuming data.
 // So there is no risk of false sharing. No cacheline boundary alignment allows CPU to read more data per one fetch thus less latency.
 // This is from benchmark.
@@ -18,6 +29,8 @@ struct ElementData
 {
 	char name[255];
 	int id;
+	// steadyNowNs() when writer published it, so reader can measure one-way latency
+	std::uint64_t sent_ns;
 
 	friend std::ostream& operator<<(std::ostream& os, const ElementData& obj)
 	{
@@ -26,18 +39,225 @@ struct ElementData
 	}
 };
 
+// process-shared futex word to park on, see futex.h
+struct FutexWaitWord
+{
+	alignas(64) std::atomic<std::uint32_t> seq;
+	// number of parked (or about to park) waiters, notifier only issues FUTEX_WAKE when it's not zero
+	std::atomic<std::uint32_t> waiters;
+};
+
+// What producer of BasicRingBuffer does when the ring is full
+enum class FullPolicy : std::uint32_t
+{
+	// wait until consumer frees a slot
+	Block,
+	// throw the new element away and count it in 'dropped'
+	DropNewest,
+	// write over the oldest element, consumer detects it through per-slot sequences and counts it in 'overwritten'
+	OverwriteOldest
+};
+
+// Which ring a segment holds, writer and reader have to be built for the same one
+enum class RingKind : std::uint32_t
+{
+	// RingBuffer, sized at runtime
+	Spsc,
+	// MPMCRingBuffer, USE_MPMC build
+	Mpmc,
+	// BroadcastWriter/BroadcastReader, USE_BROADCAST build
+	Broadcast,
+	// ByteRingBuffer, USE_BYTES build
+	Bytes
+};
+
+#if defined(USE_MPMC)
+const RingKind sRingKind = RingKind::Mpmc;
+#elif defined(USE_BROADCAST)
+const RingKind sRingKind = RingKind::Broadcast;
+#elif defined(USE_BYTES)
+const RingKind sRingKind = RingKind::Bytes;
+#else
+const RingKind sRingKind = RingKind::Spsc;
+#endif
+
+// Counters of BasicRingBuffer, only written by producer, read by 'shmstat'.
+// puts / publishes is the mean number of elements published with one store of head.
+struct ProducerStats
+{
+	alignas(64) std::atomic<std::uint64_t> puts;
+	std::atomic<std::uint64_t> publishes;
+	// times producer found the ring full, whether it then waited, dropped or gave up
+	std::atomic<std::uint64_t> full_stalls;
+};
+
+// Counters of BasicRingBuffer, only written by consumer, read by 'shmstat'
+struct ConsumerStats
+{
+	alignas(64) std::atomic<std::uint64_t> gets;
+	// stores of tail, gets / releases is the mean batch
+	std::atomic<std::uint64_t> releases;
+	// times consumer found nothing to get
+	std::atomic<std::uint64_t> empty_polls;
+	// most elements consumer has found waiting for it at once
+	std::atomic<std::uint64_t> max_occupancy;
+};
+
 struct RingBufferCtrlFields
 {
-	alignas(64) std::atomic<int> head;
-	alignas(64) std::atomic<int> tail;
+	// free-running positions, they never wrap, see BasicRingBuffer
+	alignas(64) std::atomic<std::uint64_t> head;
+	// only written by producer, next to head as producer owns this cache line
+	std::atomic<std::uint64_t> dropped;
+
+	alignas(64) std::atomic<std::uint64_t> tail;
+	// only written by consumer
+	std::atomic<std::uint64_t> overwritten;
+
+	// consumer waits on not_empty, producer waits on not_full
+	FutexWaitWord not_empty;
+	FutexWaitWord not_full;
+
+	// set by consumer right before it sleeps on its eventfd, cleared by producer when it signals, see eventfd.h
+	alignas(64) std::atomic<std::uint32_t> consumer_sleeping;
+
+	// on lines of their own, so reading them never touches head or tail
+	ProducerStats producer_stats;
+	ConsumerStats consumer_stats;
+};
+
+// enqueue/dequeue positions of MPMCRingBuffer, they only grow and never wrap
+struct MPMCCtrlFields
+{
+	alignas(64) std::atomic<std::uint64_t> enqueue_pos;
+	alignas(64) std::atomic<std::uint64_t> dequeue_pos;
+};
+
+// slot of MPMCRingBuffer, 'seq' tells whether the slot is ready to be written or read for the current lap
+template <typename T>
+struct MPMCSlot
+{
+	std::atomic<std::uint64_t> seq;
+	T data;
+};
+
+// cursor of a single reader of broadcast ring, only written by the reader which owns it
+struct BroadcastCursor
+{
+	enum State : std::uint32_t
+	{
+		Free = 0,
+		Joining,
+		Active
+	};
+
+	alignas(64) std::atomic<std::uint32_t> state;
+	std::atomic<std::uint64_t> pos;
+};
+
+const int sMaxBroadcastReaders = 16;
+struct BroadcastCtrlFields
+{
+	BroadcastCursor cursors[sMaxBroadcastReaders];
+};
+
+// only written by writer of broadcast ring, readers can map it read-only.
+// page-aligned (thus page-sized) so that mprotect() won't affect its neighbours.
+template <typename T, std::size_t N>
+struct alignas(4096) BroadcastData
+{
+	alignas(64) std::atomic<std::uint64_t> head;
+	alignas(64) T elems[N];
+};
+
+// byte offsets of ByteRingBuffer, they only grow and never wrap
+struct ByteRingCtrlFields
+{
+	alignas(64) std::atomic<std::uint64_t> head;
+	alignas(64) std::atomic<std::uint64_t> tail;
+};
+
+// Describes the segment to whoever attaches to it, see segment.h
+struct SegmentHeader
+{
+	std::atomic<std::uint64_t> magic;
+	std::uint32_t version;
+	std::uint32_t element_size;
+	// of RingBuffer, in elements
+	std::uint64_t capacity;
+	std::uint64_t ctrl_offset;
+	std::uint64_t data_offset;
+	// of RingBuffer's per-slot sequences, see FullPolicy::OverwriteOldest
+	std::uint64_t seq_offset;
+	std::uint64_t segment_size;
+	// FullPolicy of writer, readers of an overwriting ring have to read it differently
+	std::uint32_t full_policy;
+	// RingKind of writer, RingBuffer's capacity is 0 unless it's Spsc
+	std::uint32_t ring_kind;
+	// of LastValueCache after the sequences, capacity is 0 when writer keeps none
+	std::uint32_t lvc_capacity;
+	std::uint64_t lvc_offset;
 };
 
-const int sElementSize = 500;
+// Named ring in a channel segment, see channel.h. Offsets are from the start of the segment.
+const std::size_t sChannelNameSize = 32;
+struct ChannelEntry
+{
+	enum State : std::uint32_t
+	{
+		Free = 0,
+		Creating,
+		Ready
+	};
+
+	std::atomic<std::uint32_t> state;
+	// null-terminated
+	char name[sChannelNameSize];
+	std::uint64_t capacity;
+	std::uint64_t ctrl_offset;
+	std::uint64_t data_offset;
+	std::uint64_t seq_offset;
+};
+
+// Start of a channel segment, rings of the channels follow it
+const int sMaxChannels = 64;
+struct ChannelDirectoryHeader
+{
+	std::atomic<std::uint64_t> magic;
+	std::uint32_t version;
+	std::uint32_t element_size;
+	std::uint64_t segment_size;
+	// bytes of the segment handed out so far, rings are allocated by bumping it
+	std::atomic<std::uint64_t> used;
+
+	alignas(64) std::atomic<bool> operational;
+
+	alignas(64) ChannelEntry entries[sMaxChannels];
+};
+
+// default capacity of RingBuffer, and capacity of the other rings
+// has to be power of two, see BasicRingBuffer
+const int sElementSize = 512;
+// in bytes, has to be power of two, see ByteRingBuffer
+const std::size_t sByteRingSize = 64 * 1024;
+// RingBuffer's elements follow right after it, then their sequences, as many as SegmentHeader says.
+// Other rings have their storage here instead, only the one the binary is built for, see RingKind.
 struct SharedData
 {
+	SegmentHeader header;
 	alignas(64) std::atomic<bool> operational;
 	RingBufferCtrlFields rb_ctrl_fields;
-	ElementData elems[sElementSize];
+
+#if defined(USE_MPMC)
+	MPMCCtrlFields mpmc_ctrl_fields;
+	MPMCSlot<ElementData> mpmc_elems[sElementSize];
+#elif defined(USE_BROADCAST)
+	alignas(4096) BroadcastCtrlFields bcast_ctrl_fields;
+	BroadcastData<ElementData, sElementSize> bcast_data;
+#elif defined(USE_BYTES)
+	ByteRingCtrlFields bytes_ctrl_fields;
+	alignas(64) std::byte bytes[sByteRingSize];
+#endif
 };
 
 // RAII of pthread_rwlock_wrlock
@@ -148,13 +368,23 @@ struct ShmFd
 		m_name(name)
 	{}
 
+	// 'name' is a path of a regular file (e.g. on hugetlbfs) rather than a shm_open() name
+	ShmFd(int fd, std::string_view name, bool is_file):
+		m_fd(fd),
+		m_name(name),
+		m_is_file(is_file)
+	{}
+
 	~ShmFd()
 	{
 		if (m_fd != -1)
 		{
 			std::cout << "ShmFd - releases resource" << std::endl;
 			close(m_fd);
-			shm_unlink(m_name.data());
+			if (m_is_file)
+				unlink(m_name.data());
+			else
+				shm_unlink(m_name.data());
 		}
 	}
 
@@ -172,6 +402,7 @@ struct ShmFd
 private:
 	int m_fd = -1;
 	std::string_view m_name;
+	bool m_is_file = false;
 };
 
 // client side, won't call shm_unlink()
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <sched.h>
+#include <type_traits>
+
+#include "lib.h"
+
+using namespace lib;
+
+// Bounded multi-producer multi-consumer ring buffer operating through pointer
+//
+// Each slot carries a sequence number. For position 'pos', a slot is free to write when seq == pos, and ready to read
+// when seq == pos + 1. Producers and consumers claim a position with a single CAS on enqueue_pos (or dequeue_pos),
+// then only touch the claimed slot, so they never serialize on a lock and can't take the same element twice.
+//
+// Slots have to be initialized once with init() by the process which creates the segment (writer).
+template <typename T, std::size_t Capacity>
+class MPMCRingBuffer
+{
+	static_assert(Capacity > 1 && (Capacity & (Capacity - 1)) == 0, "Capacity must be power of two");
+	static_assert(std::is_trivially_copyable_v<T>, "T must be trivially copyable to live in shared memory");
+
+	static constexpr std::uint64_t sMask = Capacity - 1;
+
+public:
+	using Slot = MPMCSlot<T>;
+
+	MPMCRingBuffer(Slot* slots_ptr, MPMCCtrlFields* ctrl_ptr) :
+		m_slots(slots_ptr),
+		m_ctrl(ctrl_ptr)
+	{
+		assert(m_slots != nullptr);
+		assert(m_ctrl != nullptr);
+	}
+
+	static constexpr std::size_t capacity()
+	{
+		return Capacity;
+	}
+
+	// not safe to call while there are other producers or consumers
+	void init()
+	{
+		for (std::size_t i=0; i<Capacity; ++i)
+			m_slots[i].seq.store(i, std::memory_order_relaxed);
+
+		m_ctrl->enqueue_pos.store(0, std::memory_order_relaxed);
+		m_ctrl->dequeue_pos.store(0, std::memory_order_release);
+	}
+
+	// Return false if ring is full
+	bool tryPut(const T& obj)
+	{
+		std::uint64_t pos = m_ctrl->enqueue_pos.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			Slot& slot = m_slots[pos & sMask];
+			const std::uint64_t seq = slot.seq.load(std::memory_order_acquire);
+			const std::int64_t diff = static_cast<std::int64_t>(seq - pos);
+
+			if (diff == 0)
+			{
+				// slot is free for this lap, try to claim it. On failure 'pos' is updated to the current value.
+				if (m_ctrl->enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					slot.data = obj;
+					slot.seq.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			// slot still holds an element of the previous lap which hasn't been consumed
+			else if (diff < 0)
+				return false;
+			// another producer claimed this position already
+			else
+				pos = m_ctrl->enqueue_pos.load(std::memory_order_relaxed);
+		}
+	}
+
+	void put(const T& obj)
+	{
+		while (!tryPut(obj))
+		{
+			// relinquish the current thread, so more chance that consumers get to run
+			sched_yield();
+		}
+	}
+
+	// Return false if there is no element to return
+	bool get(T& rdata)
+	{
+		std::uint64_t pos = m_ctrl->dequeue_pos.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			Slot& slot = m_slots[pos & sMask];
+			const std::uint64_t seq = slot.seq.load(std::memory_order_acquire);
+			const std::int64_t diff = static_cast<std::int64_t>(seq - (pos + 1));
+
+			if (diff == 0)
+			{
+				if (m_ctrl->dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					rdata = slot.data;
+					// hand the slot over to producer of the next lap
+					slot.seq.store(pos + Capacity, std::memory_order_release);
+					return true;
+				}
+			}
+			// producer hasn't published this position yet
+			else if (diff < 0)
+				return false;
+			// another consumer took this position already
+			else
+				pos = m_ctrl->dequeue_pos.load(std::memory_order_relaxed);
+		}
+	}
+
+	// approximate, as positions can move while being read
+	std::size_t size()
+	{
+		const std::uint64_t dequeue_pos = m_ctrl->dequeue_pos.load(std::memory_order_acquire);
+		const std::uint64_t enqueue_pos = m_ctrl->enqueue_pos.load(std::memory_order_acquire);
+		return enqueue_pos > dequeue_pos ? enqueue_pos - dequeue_pos : 0;
+	}
+
+private:
+	// disable copy-construct, and assignment operator
+	MPMCRingBuffer(const MPMCRingBuffer&);
+	MPMCRingBuffer(MPMCRingBuffer&&);
+	MPMCRingBuffer& operator=(MPMCRingBuffer&);
+	MPMCRingBuffer& operator=(MPMCRingBuffer&&);
+
+private:
+	Slot* m_slots = nullptr;
+	MPMCCtrlFields* m_ctrl = nullptr;
+};
@@ -1,8 +1,22 @@
 /**
- * Consumer process will continue reading data as assigned from the writer process with delay in each iteraion of reading.
+ * Consumer process will continue reading data as assigned from the writer process, blocking until there is data to read.
+ * (MPMC, broadcast and bytes builds poll with delay in each iteraion of reading instead.)
  * It will automatically break out from the loop if the writer process has terminated via checking 'operational' flag.
  *
  * Notice that there is no logic to avoid reading the old data as written into shared memory.
+ *
+ * Usage: ./reader [--name /name] [--prefault] [--cpus LIST] [--epoll] [--lvc] [--trace] [--samples FILE [--max-samples N]]
+ * --name is the shared memory segment writer created (default /osimhen), its layout is checked on attach.
+ * --prefault maps all of it up front and locks it.
+ * --cpus pins reader to CPUs in taskset format (ex. 0,2-3).
+ * --epoll waits in epoll for the eventfd of 'writer --eventfd' instead of on futex, as an epoll-driven service would.
+ * --lvc leaves the ring alone and reads the LastValueCache of 'writer --lvc' instead, printing every 100ms only the
+ * ids which changed since, so updates overwritten in between cost it nothing.
+ * --trace records ring operations into the trace segment created by 'writer --trace'.
+ * --samples (BENCH_LATENCY build only) also records every latency as a binary sample into FILE, up to --max-samples
+ * of them (default 1048576), see samples.h and 'samples2csv'.
+ *
+ * Segment of 'writer-overwrite' needs USE_OVERWRITE build of reader, which reports elements it lost to writer.
  */
 #include <iostream>
 #include <fcntl.h>
@@ -14,33 +28,102 @@
 #include <random>
 #include <thread>
 #include <chrono>
-
-#ifdef BENCH_LATENCY
-#include <fstream>
-#endif
+#include <string_view>
+#include <unordered_map>
+#include <memory>
+#include <sys/epoll.h>
 
 #include "lib.h"
 #include "ringbuffer.h"
+#include "histogram.h"
+#include "mpmc_ringbuffer.h"
+#include "broadcast_ringbuffer.h"
+#include "byte_ringbuffer.h"
+#include "trace.h"
+#include "segment.h"
+#include "affinity.h"
+#include "eventfd.h"
+#include "lastvalue.h"
+#include "samples.h"
 
 using namespace lib;
 
+// only RingBuffer notifies readers, other rings are polled
+#if defined(USE_MPMC) || defined(USE_BROADCAST) || defined(USE_BYTES)
+#define POLLING_RING
+#endif
+
+// producer's policy only changes consumer when elements can be written over
+#ifdef USE_OVERWRITE
+const FullPolicy sFullPolicy = FullPolicy::OverwriteOldest;
+#else
+const FullPolicy sFullPolicy = FullPolicy::Block;
+#endif
+
+#if defined(BENCH_LATENCY) && defined(USE_BYTES)
+#error "BENCH_LATENCY measures rings of ElementData"
+#endif
+
 ShmFdClient* s_shm_fd_obj = nullptr;
 MMap* s_mmap = nullptr;
 SharedData *s_ptr = nullptr;
 
+ShmFdClient* s_trace_shm_fd_obj = nullptr;
+MMap* s_trace_mmap = nullptr;
+
+#ifdef USE_BROADCAST
+BroadcastReader<ElementData, sElementSize>* s_bcast_reader = nullptr;
+#endif
+
 #ifdef BENCH_LATENCY
-std::ofstream *s_ts_output_file = nullptr;
+LatencyHistogram* s_histogram = nullptr;
+SampleRecorder* s_recorder = nullptr;
 #endif
 
+// Conflating consumer, only looks at the latest element of every id once in a while
+int readLastValues(SharedData* ptr)
+{
+	LastValueCache<ElementData> lvc(lastValueEntries(ptr), ptr->header.lvc_capacity);
+	// version of every id when it was last printed
+	std::unordered_map<int, std::uint32_t> seen;
+
+	bool operational = true;
+	while (operational)
+	{
+		std::size_t changed = 0;
+		lvc.forEach([&](int id, const ElementData& elem, std::uint32_t version) {
+			auto [it, inserted] = seen.try_emplace(id, version);
+			if (!inserted && it->second == version)
+				return;
+			it->second = version;
+			++changed;
+			std::cout << elem << std::endl;
+		});
+
+		if (changed == 0)
+			operational = ptr->operational.load(std::memory_order_acquire);
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	}
+	return 0;
+}
+
 // shared memory won't be unlinked automatically and it still exists on the machine if signal comes
 // so we handle them here.
 void signal_handler(int signal)
 {
 #ifdef BENCH_LATENCY
-	// close the file if not yet
-	// this happens when signal caught after opening the file and we are not done yet
-	if (s_ts_output_file != nullptr && s_ts_output_file->is_open())
-		s_ts_output_file->close();
+	// usual way to stop the bench, so report what we have got so far
+	if (s_histogram != nullptr)
+		s_histogram->print(std::cout);
+	// samples are in the file already, as it's mapped
+	if (s_recorder != nullptr)
+		std::cout << "recorded samples: " << s_recorder->count() << ", dropped: " << s_recorder->dropped() << "\n";
+#endif
+
+#ifdef USE_BROADCAST
+	// otherwise writer keeps waiting for our cursor
+	if (s_bcast_reader != nullptr)
+		s_bcast_reader->unregister();
 #endif
 
 	// just make a copy
@@ -50,6 +133,12 @@ void signal_handler(int signal)
 	if (s_mmap != nullptr)
 		MMap stack_value2 = *s_mmap;
 
+	if (s_trace_shm_fd_obj != nullptr)
+		ShmFdClient stack_value3 = *s_trace_shm_fd_obj;
+
+	if (s_trace_mmap != nullptr)
+		MMap stack_value4 = *s_trace_mmap;
+
 	// force exit to avoid double destructor call otherwise it will return back to normal flow within main()
 	std::exit(1);
 }
@@ -59,100 +148,292 @@ int main(int argc, char* argv[])
 	std::signal(SIGINT, signal_handler);
 	std::signal(SIGTERM, signal_handler);
 
+	// recommended to use slash prefixed from manpage
+	const char* name = sDefaultSegmentName;
+	bool trace = false;
+	bool use_epoll = false;
+	bool use_lvc = false;
+#ifdef BENCH_LATENCY
+	const char* samples_path = nullptr;
+	std::size_t max_samples = 1 << 20;
+#endif
+	MapOptions map_opts;
+	const char* cpu_list = nullptr;
+	for (int i=1; i<argc; ++i)
+	{
+		const std::string_view arg(argv[i]);
+		if (arg == "--trace")
+			trace = true;
+		else if (arg == "--epoll")
+			use_epoll = true;
+		else if (arg == "--lvc")
+			use_lvc = true;
+		else if (arg == "--prefault")
+			map_opts.prefault = true;
+		else if (arg == "--name" && i + 1 < argc)
+			name = argv[++i];
+		else if (arg == "--cpus" && i + 1 < argc)
+			cpu_list = argv[++i];
+#ifdef BENCH_LATENCY
+		else if (arg == "--samples" && i + 1 < argc)
+			samples_path = argv[++i];
+		else if (arg == "--max-samples" && i + 1 < argc)
+			max_samples = std::strtoull(argv[++i], nullptr, 10);
+#endif
+		else
+		{
+#ifdef BENCH_LATENCY
+			std::cerr << "Usage: " << argv[0] << " [--name /name] [--prefault] [--cpus LIST] [--epoll] [--lvc] [--trace] [--samples FILE [--max-samples N]]\n";
+#else
+			std::cerr << "Usage: " << argv[0] << " [--name /name] [--prefault] [--cpus LIST] [--epoll] [--lvc] [--trace]\n";
+#endif
+			return 1;
+		}
+	}
+
+	if (cpu_list != nullptr)
+	{
+		cpu_set_t cpus;
+		if (!parseCpuList(cpu_list, cpus))
+		{
+			std::cerr << "invalid CPU list " << cpu_list << "\n";
+			return 1;
+		}
+		if (!pinToCpus(cpus))
+			return 1;
+	}
+
 	// random for ms to delay each iteration of writing into shared memory
 	std::random_device rd;
 	std::mt19937 gen(rd());
 	std::uniform_int_distribution<> dis(50, 120);
 
-	// recommended to use slash prefixed from manpage
-	const char* name = "/osimhen";
-	const int SIZE = sizeof(SharedData);
+	// capacity is up to writer, so map whatever size the segment has and let its header tell the rest
+	Segment segment;
+	if (!attachSegment(name, map_opts, segment))
+		return 1;
+
+	// for RAII
+	ShmFdClient shm_fd_obj(segment.fd, name);
+	s_shm_fd_obj = &shm_fd_obj;
+
+	SharedData *ptr = static_cast<SharedData*>(segment.ptr);
+	s_ptr = ptr;
 
-	int shm_id = shm_open(name, O_RDWR, 0666);
-	if (shm_id == -1)
+	// for RAII
+	MMap mmap(ptr, segment.size);
+	s_mmap = &mmap;
+
+	if (const char* reason = checkHeader(ptr, segment.size))
 	{
-		std::cerr << "shm_open() failed\n";
+		std::cerr << "segment " << name << " can't be used: " << reason << "\n";
 		return 1;
 	}
 
-	// for RAII
-	ShmFdClient shm_fd_obj(shm_id, name);
-	s_shm_fd_obj = &shm_fd_obj;
+	if (use_lvc)
+	{
+		if (ptr->header.lvc_capacity == 0)
+		{
+			std::cerr << "segment " << name << " has no last-value cache, is writer running with --lvc?\n";
+			return 1;
+		}
+		return readLastValues(ptr);
+	}
 
-	SharedData *ptr = static_cast<SharedData*>(mmap(0, SIZE, PROT_READ | PROT_WRITE, MAP_SHARED_VALIDATE, shm_id, 0));
-	if (ptr == MAP_FAILED)
+	const bool overwriting = ptr->header.full_policy == static_cast<std::uint32_t>(FullPolicy::OverwriteOldest);
+	if (overwriting != (sFullPolicy == FullPolicy::OverwriteOldest))
 	{
-		std::cerr << "mmap() failed\n";
+		std::cerr << "segment " << name << (overwriting ? " is overwritten by writer, use reader-overwrite\n" : " is not overwritten by writer, use reader\n");
 		return 1;
 	}
 
-	s_ptr = ptr;
+#if defined(USE_MPMC)
+	MPMCRingBuffer<ElementData, sElementSize> rb(ptr->mpmc_elems, &ptr->mpmc_ctrl_fields);
+#elif defined(USE_BROADCAST)
+	// reader only ever writes its own cursor, elements are read-only from here on. A hugetlbfs mapping can only be
+	// re-protected in whole huge pages, and bcast_data shares its page with the cursors.
+	if (!segment.file_path.empty())
+		std::cerr << "segment is on huge pages, elements are left writable\n";
+	else if (mprotect(&ptr->bcast_data, sizeof(ptr->bcast_data), PROT_READ) != 0)
+	{
+		std::cerr << "mprotect() failed\n";
+		return 1;
+	}
 
-	// for RAII
-	MMap mmap(ptr, SIZE);
-	s_mmap = &mmap;
+	BroadcastReader<ElementData, sElementSize> rb(&ptr->bcast_data, ptr->bcast_ctrl_fields.cursors);
+	s_bcast_reader = &rb;
+#elif defined(USE_BYTES)
+	ByteRingBuffer<sByteRingSize> rb(ptr->bytes, &ptr->bytes_ctrl_fields);
+#else
+	PolicyRingBuffer<sFullPolicy> rb(ringElements(ptr), ringSlotSeqs(ptr), ptr->header.capacity, &ptr->rb_ctrl_fields);
+#endif
 
-	RingBuffer rb(ptr->elems, sElementSize, &ptr->rb_ctrl_fields.head, &ptr->rb_ctrl_fields.tail);
+#ifdef POLLING_RING
+	if (trace || use_epoll)
+		std::cerr << "--trace and --epoll are only supported by RingBuffer, ignored\n";
+#else
+	// eventfd of the ring goes into epoll as any other fd would
+	UniqueFd event_fd(use_epoll ? receiveEventFd(name) : -1);
+	UniqueFd epoll_fd(use_epoll ? epoll_create1(EPOLL_CLOEXEC) : -1);
+	if (use_epoll)
+	{
+		epoll_event ev = {};
+		ev.events = EPOLLIN;
+		ev.data.fd = event_fd.get();
+		if (event_fd.get() == -1 || epoll_fd.get() == -1 || epoll_ctl(epoll_fd.get(), EPOLL_CTL_ADD, event_fd.get(), &ev) != 0)
+		{
+			std::cerr << "can't get eventfd of " << name << ", is writer running with --eventfd?\n";
+			return 1;
+		}
+		rb.setEventFd(event_fd.get());
+	}
 
-	bool operational = true;
-	ElementData data;	// reuse holding data structure
+	int trace_fd = -1;
+	if (trace)
+	{
+		trace_fd = shm_open(sTraceName, O_RDWR, 0666);
+		if (trace_fd == -1)
+		{
+			std::cerr << "shm_open() failed for trace, is writer running with --trace?\n";
+			return 1;
+		}
+	}
 
-#ifdef BENCH_LATENCY
-	const char* ts_output_filename = "ts-input.txt";
-	if (argc > 1)
-		ts_output_filename = argv[1];
+	// for RAII, both are no-op when tracing is off
+	ShmFdClient trace_shm_fd_obj(trace_fd, sTraceName);
+	s_trace_shm_fd_obj = &trace_shm_fd_obj;
 
-	// ignore the current file content, open for writing and truncate them
-	std::ofstream ts_output_file(ts_output_filename, std::ios::out | std::ios::trunc);
-	if (!ts_output_file.is_open())
+	TraceShared* trace_ptr = nullptr;
+	if (trace)
 	{
-		std::cerr << "Error opening file for output benchmark of cache latency access\n";
-		return 1;
+		trace_ptr = static_cast<TraceShared*>(::mmap(0, sizeof(TraceShared), PROT_READ | PROT_WRITE, MAP_SHARED_VALIDATE, trace_fd, 0));
+		if (trace_ptr == MAP_FAILED)
+		{
+			std::cerr << "mmap() failed for trace\n";
+			return 1;
+		}
 	}
 
-	s_ts_output_file = &ts_output_file;
+	MMap trace_mmap(trace_ptr, sizeof(TraceShared));
+	s_trace_mmap = &trace_mmap;
+
+	Tracer tracer(trace_ptr);
+	if (trace)
+		rb.setTracer(&tracer);
+#endif
+
+	bool operational = true;
+
+#ifdef BENCH_LATENCY
+	ElementData data;	// reuse holding data structure
+
+	// aggregated in memory and reported at exit, nothing is written per message
+	LatencyHistogram histogram;
+	s_histogram = &histogram;
+
+	// whatever writer published before reader started has been waiting for it, not travelling
+	while (rb.get(data))
+		;
 
-	// turn off buffering of file
-	ts_output_file.rdbuf()->pubsetbuf(nullptr, 0);
-	// output header column names
-	ts_output_file << "Timestamp,Latency\n" << std::flush;
+	// preallocated and mapped up front, recording is then just stores to memory
+	std::unique_ptr<SampleRecorder> recorder;
+	if (samples_path != nullptr)
+	{
+		recorder = std::make_unique<SampleRecorder>(samples_path, max_samples);
+		s_recorder = recorder.get();
+	}
 #endif
 
 	while (operational)
 	{
-#ifdef BENCH_LATENCY
-		auto start = std::chrono::steady_clock::now();
-		bool res = rb.get(data);
-		auto end = std::chrono::steady_clock::now();
-		std::chrono::duration<double, std::micro> elapsed = end - start;
-		double elapsed_value = elapsed.count();
+#ifndef POLLING_RING
+		// block until writer publishes something instead of sleeping blindly, but wake up once in a while
+		// to check whether writer is still operational
+		bool ready = true;
+		if (use_epoll)
+		{
+			epoll_event ev;
+			if (rb.prepareSleep())
+				ready = epoll_wait(epoll_fd.get(), &ev, 1, 100) > 0;
+			rb.endSleep();
+		}
+		else
+			ready = rb.waitNotEmpty(std::chrono::milliseconds(100));
 
-		if (res)
+		if (!ready)
 		{
-			std::cout << data << std::endl;
+			operational = ptr->operational.load(std::memory_order_acquire);
+			continue;
+		}
+#endif
 
-			// current milli
-			auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(end.time_since_epoch()).count();
-			// output to the file for time series
-			ts_output_file << ms << "," << elapsed_value << "\n" << std::flush;
+#ifdef BENCH_LATENCY
+		// drain everything there is, so what's measured is travel time rather than time queued behind this loop
+		while (rb.get(data))
+		{
+			// one-way latency, from writer publishing it to here
+			const std::uint64_t now_ns = steadyNowNs();
+			histogram.record(now_ns - data.sent_ns);
+			if (recorder)
+				recorder->record(now_ns, now_ns - data.sent_ns, data.id);
+		}
+#elif defined(USE_BYTES)
+		std::span<const std::byte> msg = rb.peek();
+		if (msg.data() != nullptr)
+		{
+			std::cout << std::string_view(reinterpret_cast<const char*>(msg.data()), msg.size()) << std::endl;
+			rb.release();
 		}
 		else
 			std::cerr << "not available data\n";
-#else
+#elif defined(USE_MPMC) || defined(USE_BROADCAST)
+		ElementData data;
 		if (rb.get(data))
 			std::cout << data << std::endl;
 		else
 			std::cerr << "not available data\n";
+#elif defined(USE_OVERWRITE)
+		// slots can be written over while we look at them, so copy out
+		const std::uint64_t overwritten = rb.overwritten();
+		ElementData data;
+		if (rb.get(data))
+		{
+			if (rb.overwritten() != overwritten)
+				std::cerr << "lost " << rb.overwritten() - overwritten << " elements overwritten by writer\n";
+			std::cout << data << std::endl;
+		}
+		else
+			std::cerr << "not available data\n";
+#else
+		// inspect the element in place, then hand the slot back
+		if (const ElementData* elem = rb.peek())
+		{
+			std::cout << *elem << std::endl;
+			rb.release(1);
+		}
+		else
+			std::cerr << "not available data\n";
 #endif
 
 		//RWUniqueLock _opt_lock(&ptr->rwlock);
 		operational = ptr->operational.load(std::memory_order_acquire);
 		//_opt_lock.unlock();
 
-		// random delay time in ms
+#if defined(POLLING_RING) && defined(BENCH_LATENCY)
+		// a sleep would be measured as latency of whatever arrives meanwhile
+		sched_yield();
+#elif defined(POLLING_RING)
+		// these rings don't notify, so poll with random delay time in ms
 		int delay_ms = dis(gen);
 		std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
+#endif
 	}
 
+#ifdef BENCH_LATENCY
+	histogram.print(std::cout);
+	if (recorder)
+		std::cout << "recorded samples: " << recorder->count() << ", dropped: " << recorder->dropped() << "\n";
+#endif
+
 	return 0;
 }
@@ -2,143 +2,849 @@
 
 #include <cassert>
 #include <sched.h>
+#include <span>
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+#include <chrono>
+#include <cstdint>
 
 #include "lib.h"
+#include "futex.h"
+#include "trace.h"
+#include "eventfd.h"
 
 using namespace lib;
 
+// How producer and consumer observe the index owned by the other side
+enum class IndexCaching
+{
+	// load both head and tail from shared memory on every check
+	None,
+	// producer keeps a private copy of tail, consumer keeps a private copy of head, and each re-reads the shared
+	// index only when its cached view says full (or empty). Each side then mostly touches only its own cache line.
+	Local
+};
+
+// Up to two runs of contiguous slots, 'second' is only non-empty when the run wraps around the end of buffer
+template <typename T>
+struct SlotSpans
+{
+	std::span<T> first;
+	std::span<T> second;
+
+	std::size_t size() const
+	{
+		return first.size() + second.size();
+	}
+
+	bool empty() const
+	{
+		return first.empty();
+	}
+};
+
+// Capacity of BasicRingBuffer only known at runtime, it has to be passed to the constructor
+constexpr std::size_t sDynamicCapacity = 0;
+
 // Ring buffer operating through pointer
-class RingBuffer
+//
+// head and tail are free-running 64-bit positions which never wrap, slot of a position is derived by masking it.
+// So full and empty are told apart without leaving a slot unused, and size() is a single subtraction.
+// Capacity has to be power of two, so deriving the slot is just a bitmask instead of integer division by a runtime
+// value. It's normally known at compile time so the mask is a constant, with sDynamicCapacity it's given to the
+// constructor instead, and the mask is a member. T can be any trivially copyable type as it lives in shared memory
+// and is copied in/out as raw bytes.
+//
+// With IndexCaching::Local, cached indices are private to this object, so an instance is meant to be used by either
+// producer or consumer, as writer and reader processes do.
+//
+// Policy decides what producer does when the ring is full, see FullPolicy. With FullPolicy::OverwriteOldest producer
+// never looks at tail, and stamps every slot with a sequence derived from its position, seqlock-like:
+// 2 * pos + 1 while the element at 'pos' is being written, 2 * pos + 2 once it's there. An unexpected sequence tells
+// consumer the element is not there yet or has been written over.
+template <typename T, std::size_t Capacity, IndexCaching Caching = IndexCaching::Local, FullPolicy Policy = FullPolicy::Block>
+class BasicRingBuffer
 {
+	static_assert(Capacity == sDynamicCapacity || (Capacity > 1 && (Capacity & (Capacity - 1)) == 0), "Capacity must be power of two");
+	static_assert(std::is_trivially_copyable_v<T>, "T must be trivially copyable to live in shared memory");
+
+	static constexpr std::size_t sMask = Capacity - 1;
+
 public:
 	// accept the pointer to the shared data to mgmt fields
-    RingBuffer(ElementData* buffer_ptr, int buffer_size, std::atomic<int>* head_ptr, std::atomic<int>* tail_ptr) :
-	    m_buffer(buffer_ptr),
-	    m_buffer_size(buffer_size),
-	    m_head(head_ptr),
-	    m_tail(tail_ptr)
-    {
+	BasicRingBuffer(T* buffer_ptr, std::atomic<std::uint64_t>* head_ptr, std::atomic<std::uint64_t>* tail_ptr) :
+		m_buffer(buffer_ptr),
+		m_head(head_ptr),
+		m_tail(tail_ptr)
+	{
 		assert(m_buffer != nullptr);
-		assert(m_buffer_size > 0);
 		assert(m_head != nullptr);
 		assert(m_tail != nullptr);
-    }
 
-    bool isFull()
-    {
-        return _isFull_nolock();
-    }
+		m_cached_head = m_head->load(std::memory_order_acquire);
+		m_cached_tail = m_tail->load(std::memory_order_acquire);
+	}
+
+	// With wait words, put() parks on futex instead of spinning when ring is full, and waitNotEmpty() is available
+	BasicRingBuffer(T* buffer_ptr, RingBufferCtrlFields* ctrl_ptr) :
+		BasicRingBuffer(buffer_ptr, &ctrl_ptr->head, &ctrl_ptr->tail)
+	{
+		m_not_empty = &ctrl_ptr->not_empty;
+		m_not_full = &ctrl_ptr->not_full;
+		m_dropped = &ctrl_ptr->dropped;
+		m_overwritten = &ctrl_ptr->overwritten;
+		m_consumer_sleeping = &ctrl_ptr->consumer_sleeping;
+		m_producer_stats = &ctrl_ptr->producer_stats;
+		m_consumer_stats = &ctrl_ptr->consumer_stats;
+	}
+
+	// Size has to match Capacity, unless it's sDynamicCapacity in which case this is how the ring gets its capacity
+	BasicRingBuffer(T* buffer_ptr, int buffer_size, std::atomic<std::uint64_t>* head_ptr, std::atomic<std::uint64_t>* tail_ptr) :
+		BasicRingBuffer(buffer_ptr, head_ptr, tail_ptr)
+	{
+		_setCapacity(buffer_size);
+	}
+
+	// As with RingBufferCtrlFields above, with capacity e.g. from SegmentHeader
+	BasicRingBuffer(T* buffer_ptr, std::size_t capacity, RingBufferCtrlFields* ctrl_ptr) :
+		BasicRingBuffer(buffer_ptr, ctrl_ptr)
+	{
+		_setCapacity(capacity);
+	}
+
+	// With 'capacity' per-slot sequences as well, which FullPolicy::OverwriteOldest requires.
+	// Consumer resumes from tail, or from the oldest element still there if producer has lapped it since.
+	BasicRingBuffer(T* buffer_ptr, std::atomic<std::uint64_t>* slot_seqs, std::size_t capacity, RingBufferCtrlFields* ctrl_ptr) :
+		BasicRingBuffer(buffer_ptr, capacity, ctrl_ptr)
+	{
+		assert(slot_seqs != nullptr);
+		m_slot_seqs = slot_seqs;
+
+		if constexpr (Policy == FullPolicy::OverwriteOldest)
+		{
+			m_write_pos = m_head->load(std::memory_order_acquire);
+			m_read_pos = std::max(m_tail->load(std::memory_order_acquire), m_write_pos - std::min<std::uint64_t>(m_write_pos, capacity));
+		}
+	}
+
+	std::size_t capacity() const
+	{
+		return _mask() + 1;
+	}
+
+	// Record every put/get into 'tracer', nullptr turns it off.
+	// Indices of the other side are as last seen by this side.
+	void setTracer(Tracer* tracer)
+	{
+		m_tracer = tracer;
+	}
+
+	// Signal 'event_fd' when producer publishes while consumer sleeps, see eventfd.h. Both sides set the same
+	// eventfd, and it requires RingBufferCtrlFields. -1 turns it off.
+	void setEventFd(int event_fd)
+	{
+		assert(event_fd == -1 || m_consumer_sleeping != nullptr);
+		m_event_fd = event_fd;
+	}
+
+	// Consumer side, call right before waiting for the eventfd to be readable. Return false if there is something
+	// to get already, then don't wait. Either way call endSleep() afterwards.
+	bool prepareSleep()
+	{
+		assert(m_event_fd != -1);
+		m_consumer_sleeping->store(1, std::memory_order_relaxed);
+		// pairs with the fence in _notifyNotEmpty(), so either producer sees us sleeping or we see what it published
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		return _consumerSeesEmpty();
+	}
+
+	void endSleep()
+	{
+		m_consumer_sleeping->store(0, std::memory_order_relaxed);
+		drainEventFd(m_event_fd);
+	}
+
+	// Number of elements put() and claim() threw away with FullPolicy::DropNewest, 0 without RingBufferCtrlFields
+	std::uint64_t dropped() const
+	{
+		return m_dropped != nullptr ? m_dropped->load(std::memory_order_relaxed) : 0;
+	}
+
+	// Number of elements consumer lost to producer with FullPolicy::OverwriteOldest, 0 without RingBufferCtrlFields
+	std::uint64_t overwritten() const
+	{
+		return m_overwritten != nullptr ? m_overwritten->load(std::memory_order_relaxed) : 0;
+	}
+
+	bool isFull()
+	{
+		return _isFull_nolock();
+	}
 
 private:
-    bool _isFull_nolock()
-    {
-        const size_t s = m_buffer_size;
-        return ((s + m_head->load(std::memory_order_acquire) - m_tail->load(std::memory_order_acquire)) % s) + 1 >= s;  
-    }
+	bool _isFull_nolock()
+	{
+		const std::uint64_t tail = m_tail->load(std::memory_order_acquire);
+		return m_head->load(std::memory_order_acquire) - tail >= capacity();
+	}
+
+	// Return number of free slots as seen by producer, 'wanted' is how many slots it needs.
+	// Cached tail is only refreshed when it can't satisfy 'wanted'.
+	std::size_t _freeSlots(std::uint64_t head, std::size_t wanted)
+	{
+		if constexpr (Caching == IndexCaching::Local)
+		{
+			std::size_t free_slots = capacity() - (head - m_cached_tail);
+			if (free_slots >= wanted)
+				return free_slots;
+
+			m_cached_tail = m_tail->load(std::memory_order_acquire);
+			return capacity() - (head - m_cached_tail);
+		}
+		else
+			return capacity() - (head - m_tail->load(std::memory_order_acquire));
+	}
+
+	// Return number of available slots as seen by consumer, counterpart of _freeSlots()
+	std::size_t _availableSlots(std::uint64_t tail, std::size_t wanted)
+	{
+		if constexpr (Caching == IndexCaching::Local)
+		{
+			std::size_t available = m_cached_head - tail;
+			if (available >= wanted)
+				return available;
+
+			m_cached_head = m_head->load(std::memory_order_acquire);
+			return _noteOccupancy(m_cached_head - tail);
+		}
+		else
+			return _noteOccupancy(m_head->load(std::memory_order_acquire) - tail);
+	}
 
 	// disable copy-construct, and assignment operator
-	RingBuffer(const RingBuffer&);
-	RingBuffer(RingBuffer&&);
-	RingBuffer& operator=(RingBuffer&);
-	RingBuffer& operator=(RingBuffer&&);
+	BasicRingBuffer(const BasicRingBuffer&);
+	BasicRingBuffer(BasicRingBuffer&&);
+	BasicRingBuffer& operator=(BasicRingBuffer&);
+	BasicRingBuffer& operator=(BasicRingBuffer&&);
 
 public:
-    bool isEmpty()
-    {
-        return !_isFull_nolock() && (m_head->load(std::memory_order_acquire) == m_tail->load(std::memory_order_acquire));
-    }
+	bool isEmpty()
+	{
+		return m_head->load(std::memory_order_acquire) == m_tail->load(std::memory_order_acquire);
+	}
 
-    void put(const ElementData& obj)
-    {
-        while (isFull())
+	// Blocks while ring is full only with FullPolicy::Block
+	void put(const T& obj)
+	{
+		if constexpr (Policy == FullPolicy::Block)
 		{
-			// relinquish the current thread to the back of the queue
-			// allow other threads even on other processes to execute, so more chance that reader process will read something from the queue.
-			sched_yield();
+			*claim() = obj;
+			commit();
+		}
+		else if (!tryPut(obj))
+			_count(m_dropped, 1);
+	}
 
-			// there might be better option to do this
+	// Non-blocking counterpart of put(), return false if ring is full.
+	// Never fails with FullPolicy::OverwriteOldest, and nothing is counted as dropped when it fails.
+	bool tryPut(const T& obj)
+	{
+		if constexpr (Policy == FullPolicy::OverwriteOldest)
+		{
+			*_beginWrite(m_write_pos) = obj;
+			_endWrite(m_write_pos);
+			++m_write_pos;
+			_publishHead(1);
+			return true;
 		}
 
-		int head = m_head->load(std::memory_order_acquire);
+		if (_producerSeesFull())
+		{
+			_countFullStall();
+			return false;
+		}
 
-        m_buffer[head] = obj;
-        m_head->store((head + 1) % m_buffer_size, std::memory_order_release);
+		const std::uint64_t head = m_head->load(std::memory_order_relaxed);
+		m_buffer[head & _mask()] = obj;
+		m_head->store(head + 1, std::memory_order_release);
+		_notifyNotEmpty();
+		_countPublish(1);
+		_trace(TraceOp::Put, head + 1, m_cached_tail);
+		return true;
+	}
 
-		std::cout << "Head: " << m_head->load(std::memory_order_acquire) << ", Tail: " << m_tail->load(std::memory_order_acquire) << std::endl;
-    }
+	// Block until there is an element to get, or timeout has passed. Return false on timeout.
+	// Requires wait words, see constructor.
+	bool waitNotEmpty(std::chrono::nanoseconds timeout = std::chrono::nanoseconds::max())
+	{
+		assert(m_not_empty != nullptr);
+		return waitFor(m_not_empty, [this]() { return !_consumerSeesEmpty(); }, timeout);
+	}
 
-	bool get(ElementData& rdata)
+	bool get(T& rdata)
 	{
-		return getImpl(rdata);
+		if constexpr (Policy == FullPolicy::OverwriteOldest)
+			return _getSeq(rdata);
+		else
+			return getImpl(rdata);
 	}
 
-    void reset()
-    {
-        m_head->store(0, std::memory_order_release);
-        m_tail->store(0, std::memory_order_release);
-        // TODO: shall we reset value of all element as well ?
-    }
+	// Catch up with producer, skip all available elements but the latest one so that's what get() returns next.
+	// Return number of elements skipped, they are not counted as overwritten.
+	std::size_t skipToLatest()
+	{
+		if constexpr (Policy == FullPolicy::OverwriteOldest)
+		{
+			const std::uint64_t next = m_head->load(std::memory_order_acquire);
+			if (next <= m_read_pos + 1)
+				return 0;
+
+			const std::size_t skipped = next - 1 - m_read_pos;
+			m_read_pos = next - 1;
+			m_tail->store(m_read_pos, std::memory_order_release);
+			return skipped;
+		}
+		else
+		{
+			// only consumer modifies tail
+			const std::uint64_t tail = m_tail->load(std::memory_order_relaxed);
+			const std::uint64_t head = m_head->load(std::memory_order_acquire);
+			m_cached_head = head;
+
+			const std::size_t available = head - tail;
+			if (available <= 1)
+				return 0;
 
-    size_t size()
-    {
-        if (isFull())
-			return m_buffer_size;
-        else
-        {
-            // head can be at index less than tail
-            return (m_buffer_size + m_head->load(std::memory_order_acquire) - m_tail->load(std::memory_order_acquire)) % m_buffer_size;
-        }
-    }
+			m_tail->store(head - 1, std::memory_order_release);
+			_notify(m_not_full);
+			_trace(TraceOp::Get, head, head - 1);
+			return available - 1;
+		}
+	}
+
+	void reset()
+	{
+		m_head->store(0, std::memory_order_release);
+		m_tail->store(0, std::memory_order_release);
+		// TODO: shall we reset value of all element as well ?
+	}
 
-    void printAllElements()
-    {
-        // isEmpty() already locked
-        if (!isEmpty())
-        {
-            std::size_t optSize = size();
+	// Exact for either side, as its own index can't move meanwhile. Anyone else gets a snapshot, tail is loaded first
+	// so it's never more than head, and it's capped as head may have moved on by a whole ring since.
+	size_t size()
+	{
+		const std::uint64_t tail = m_tail->load(std::memory_order_acquire);
+		return std::min<std::uint64_t>(m_head->load(std::memory_order_acquire) - tail, capacity());
+	}
 
-            int tailCopy = m_tail->load(std::memory_order_acquire);
-            for (std::size_t i=0; i<optSize-1; i++)
-            {
-                std::cout << m_buffer[tailCopy] << "\n";
-                tailCopy = (tailCopy + 1) % m_buffer_size;
-            }
-        }
-    }
+	void printAllElements()
+	{
+		std::size_t optSize = size();
+
+		std::uint64_t tailCopy = m_tail->load(std::memory_order_acquire);
+		for (std::size_t i=0; i<optSize; i++)
+			std::cout << m_buffer[tailCopy++ & _mask()] << "\n";
+	}
 
 private:
-	
-	// Return -1 if there is no more element to return
-	bool getImpl(ElementData& rdata)
+
+	bool _producerSeesFull()
 	{
-		if (isEmpty())
+		if constexpr (Policy == FullPolicy::OverwriteOldest)
 			return false;
+		else if constexpr (Caching == IndexCaching::Local)
+			return _freeSlots(m_head->load(std::memory_order_relaxed), 1) == 0;
+		else
+			return isFull();
+	}
+
+	bool _consumerSeesEmpty()
+	{
+		if constexpr (Policy == FullPolicy::OverwriteOldest)
+			return m_slot_seqs[m_read_pos & _mask()].load(std::memory_order_acquire) < 2 * m_read_pos + 2;
+		else if constexpr (Caching == IndexCaching::Local)
+			return _availableSlots(m_tail->load(std::memory_order_relaxed), 1) == 0;
+		else
+			return isEmpty();
+	}
+
+	std::size_t _mask() const
+	{
+		if constexpr (Capacity == sDynamicCapacity)
+			return m_mask;
+		else
+			return sMask;
+	}
+
+	void _setCapacity(std::size_t capacity)
+	{
+		if constexpr (Capacity == sDynamicCapacity)
+		{
+			if (capacity < 2 || (capacity & (capacity - 1)) != 0 || capacity > (1u << 30))
+				throw std::runtime_error("Error: BasicRingBuffer capacity must be power of two, up to 2^30");
+			m_mask = capacity - 1;
+		}
+		else
+			assert(capacity == Capacity);
+	}
+
+	void _notify(FutexWaitWord* w)
+	{
+		if (w != nullptr)
+			notify(w);
+	}
+
+	// After publishing, wake consumer parked on futex or sleeping on eventfd
+	void _notifyNotEmpty()
+	{
+		_notify(m_not_empty);
+
+		if (m_event_fd != -1)
+		{
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			// only the one clearing the flag signals, a busy consumer costs one load
+			if (m_consumer_sleeping->load(std::memory_order_relaxed) != 0 && m_consumer_sleeping->exchange(0, std::memory_order_relaxed) != 0)
+				signalEventFd(m_event_fd);
+		}
+	}
+
+	void _trace(TraceOp op, std::uint64_t head, std::uint64_t tail)
+	{
+		if (m_tracer != nullptr)
+			m_tracer->record(op, head, tail);
+	}
+
+	// counters have a single writer each, so no read-modify-write is needed
+	static void _count(std::atomic<std::uint64_t>* counter, std::uint64_t n)
+	{
+		if (counter != nullptr)
+			counter->store(counter->load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+	}
+
+	// Stats are only kept with RingBufferCtrlFields, see ProducerStats and ConsumerStats
+	void _countPublish(std::size_t n)
+	{
+		if (m_producer_stats != nullptr)
+		{
+			_count(&m_producer_stats->puts, n);
+			_count(&m_producer_stats->publishes, 1);
+		}
+	}
 
-		// improved one refactoring isEmpty() but didn't see improvement much
-		//int head = m_head->load(std::memory_order_acquire);
-		int tail = m_tail->load(std::memory_order_acquire);
+	void _countFullStall()
+	{
+		if (m_producer_stats != nullptr)
+			_count(&m_producer_stats->full_stalls, 1);
+	}
 
-		//auto is_full = [s = this->m_buffer_size, head, tail]() -> bool {
-		//	return ((s + head - tail) % s) + 1 >= s;  
-		//};
-		//auto is_empty = [head, tail, is_full]() -> bool {
-		//	return !is_full() && (head == tail);
-		//};
+	void _countRelease(std::size_t n)
+	{
+		if (m_consumer_stats != nullptr)
+		{
+			_count(&m_consumer_stats->gets, n);
+			_count(&m_consumer_stats->releases, 1);
+		}
+	}
+
+	void _countEmptyPoll()
+	{
+		if (m_consumer_stats != nullptr)
+			_count(&m_consumer_stats->empty_polls, 1);
+	}
 
-		//if (is_empty())
-		//	return false;
+	// Consumer side, 'available' is fresh from head
+	std::size_t _noteOccupancy(std::size_t available)
+	{
+		if (m_consumer_stats != nullptr && available > m_consumer_stats->max_occupancy.load(std::memory_order_relaxed))
+			m_consumer_stats->max_occupancy.store(available, std::memory_order_relaxed);
+		return available;
+	}
 
-		rdata = m_buffer[tail];
-		m_tail->store((tail + 1) % m_buffer_size, std::memory_order_release);
+	// Producer side of per-slot sequences, mark the slot of 'pos' as being written and return it
+	T* _beginWrite(std::uint64_t pos)
+	{
+		assert(m_slot_seqs != nullptr);
+		m_slot_seqs[pos & _mask()].store(2 * pos + 1, std::memory_order_relaxed);
+		// element stores can't move above the odd sequence
+		std::atomic_thread_fence(std::memory_order_release);
+		return &m_buffer[pos & _mask()];
+	}
+
+	void _endWrite(std::uint64_t pos)
+	{
+		m_slot_seqs[pos & _mask()].store(2 * pos + 2, std::memory_order_release);
+	}
+
+	// consumer goes by the sequences, head tells where a consumer attaching later starts and wakes a waiting one
+	void _publishHead(std::size_t n)
+	{
+		m_head->store(m_write_pos, std::memory_order_release);
+		_notifyNotEmpty();
+		_countPublish(n);
+		_trace(TraceOp::Put, m_write_pos, m_cached_tail);
+	}
+
+	// Consumer side of per-slot sequences. Element is copied optimistically and kept only if its sequence was the
+	// expected one before and after the copy, a copy racing with producer is thrown away.
+	bool _getSeq(T& rdata)
+	{
+		assert(m_slot_seqs != nullptr);
+
+		for (;;)
+		{
+			const std::uint64_t pos = m_read_pos;
+			const std::atomic<std::uint64_t>& seq = m_slot_seqs[pos & _mask()];
+
+			// less means producer hasn't got to 'pos' yet, or is still writing it
+			const std::uint64_t s1 = seq.load(std::memory_order_acquire);
+			if (s1 < 2 * pos + 2)
+			{
+				_countEmptyPoll();
+				return false;
+			}
+
+			if (s1 == 2 * pos + 2)
+			{
+				rdata = m_buffer[pos & _mask()];
+				// element loads can't move below the second read of sequence
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (seq.load(std::memory_order_relaxed) == s1)
+				{
+					m_read_pos = pos + 1;
+					m_tail->store(m_read_pos, std::memory_order_release);
+					_countRelease(1);
+					_trace(TraceOp::Get, m_cached_head, m_read_pos);
+					return true;
+				}
+			}
+
+			// producer has lapped us, move on to the oldest element still there and count what's lost
+			const std::uint64_t latest = (seq.load(std::memory_order_acquire) - 1) / 2;
+			const std::uint64_t oldest = latest + 1 - capacity();
+			_count(m_overwritten, oldest - pos);
+			m_read_pos = oldest;
+		}
+	}
+
+	// Return -1 if there is no more element to return
+	bool getImpl(T& rdata)
+	{
+		if (_consumerSeesEmpty())
+		{
+			_countEmptyPoll();
+			return false;
+		}
+
+		// only consumer modifies tail
+		const std::uint64_t tail = m_tail->load(std::memory_order_relaxed);
+
+		rdata = m_buffer[tail & _mask()];
+		m_tail->store(tail + 1, std::memory_order_release);
+		_notify(m_not_full);
+		_countRelease(1);
+		_trace(TraceOp::Get, m_cached_head, tail + 1);
 
 		return true;
 	}
 
-	// possibly need to implement return by batch
+public:
+	// Put as many elements of 'objs' as there are free slots, then publish all of them with a single store of head.
+	// Return number of elements written which can be less than objs.size() if there is not enough free slots.
+	// This won't block, caller decides whether to retry with the remaining elements.
+	std::size_t putBatch(std::span<const T> objs)
+	{
+		if constexpr (Policy == FullPolicy::OverwriteOldest)
+		{
+			const std::size_t n = std::min(objs.size(), capacity());
+			for (std::size_t i=0; i<n; ++i)
+			{
+				*_beginWrite(m_write_pos + i) = objs[i];
+				_endWrite(m_write_pos + i);
+			}
+			m_write_pos += n;
+			if (n != 0)
+				_publishHead(n);
+			return n;
+		}
+
+		// only producer modifies head, so no need to synchronize with ourselves
+		const std::uint64_t head = m_head->load(std::memory_order_relaxed);
+
+		const std::size_t n = std::min(_freeSlots(head, objs.size()), objs.size());
+		if (n == 0)
+		{
+			if (!objs.empty())
+				_countFullStall();
+			return 0;
+		}
+
+		// contiguous slots might wrap around the end of buffer, so copy as two spans
+		const std::size_t idx = head & _mask();
+		const std::size_t first = std::min(n, capacity() - idx);
+		std::copy_n(objs.begin(), first, m_buffer + idx);
+		std::copy_n(objs.begin() + first, n - first, m_buffer);
+
+		m_head->store(head + n, std::memory_order_release);
+		_notifyNotEmpty();
+		_countPublish(n);
+		_trace(TraceOp::Put, head + n, m_cached_tail);
+		return n;
+	}
+
+	// Get up to 'max' (and no more than out.size()) available elements into 'out', then release all of the slots
+	// back to producer with a single store of tail.
+	// Return number of elements read, 0 if there is no available element.
+	std::size_t getBatch(std::span<T> out, std::size_t max)
+	{
+		if constexpr (Policy == FullPolicy::OverwriteOldest)
+		{
+			const std::size_t wanted = std::min(out.size(), max);
+			std::size_t n = 0;
+			while (n < wanted && _getSeq(out[n]))
+				++n;
+			return n;
+		}
+
+		// only consumer modifies tail
+		const std::uint64_t tail = m_tail->load(std::memory_order_relaxed);
+
+		const std::size_t wanted = std::min(out.size(), max);
+		const std::size_t n = std::min(_availableSlots(tail, wanted), wanted);
+		if (n == 0)
+		{
+			_countEmptyPoll();
+			return 0;
+		}
+
+		const std::size_t idx = tail & _mask();
+		const std::size_t first = std::min(n, capacity() - idx);
+		std::copy_n(m_buffer + idx, first, out.begin());
+		std::copy_n(m_buffer, n - first, out.begin() + first);
+
+		m_tail->store(tail + n, std::memory_order_release);
+		_notify(m_not_full);
+		_countRelease(n);
+		_trace(TraceOp::Get, m_cached_head, tail + n);
+		return n;
+	}
+
+	// Return the next element in place without copying it out, nullptr if there is none.
+	// The slot stays untouched by producer until release().
+	const T* peek()
+	{
+		static_assert(Policy != FullPolicy::OverwriteOldest, "producer may write over a peeked slot, use get()");
+
+		// only consumer modifies tail
+		const std::uint64_t tail = m_tail->load(std::memory_order_relaxed);
+		if (_availableSlots(tail, 1) == 0)
+		{
+			_countEmptyPoll();
+			return nullptr;
+		}
+
+		return &m_buffer[tail & _mask()];
+	}
+
+	// Return up to 'n' available elements in place as up to two spans (empty if there is none).
+	// They stay untouched by producer until release().
+	SlotSpans<const T> peek(std::size_t n)
+	{
+		static_assert(Policy != FullPolicy::OverwriteOldest, "producer may write over a peeked slot, use get()");
+
+		const std::uint64_t tail = m_tail->load(std::memory_order_relaxed);
+		const std::size_t wanted = n;
+		n = std::min(_availableSlots(tail, n), n);
+		if (n == 0 && wanted != 0)
+			_countEmptyPoll();
+
+		const std::size_t idx = tail & _mask();
+		const std::size_t first = std::min(n, capacity() - idx);
+		return { std::span<const T>(m_buffer + idx, first), std::span<const T>(m_buffer, n - first) };
+	}
+
+	// Hand the first 'n' peeked slots back to producer with a single store of tail.
+	// 'n' must not be more than what the last peek() returned.
+	void release(std::size_t n)
+	{
+		static_assert(Policy != FullPolicy::OverwriteOldest, "producer may write over a peeked slot, use get()");
+
+		if (n == 0)
+			return;
+
+		const std::uint64_t tail = m_tail->load(std::memory_order_relaxed);
+		m_tail->store(tail + n, std::memory_order_release);
+		_notify(m_not_full);
+		_countRelease(n);
+		_trace(TraceOp::Get, m_cached_head, tail + n);
+	}
+
+	// Block until a slot is free, then return it so producer can write into shared memory in place.
+	// Nothing is visible to consumer until commit().
+	// With FullPolicy::DropNewest it doesn't block, a full ring hands out a private element which commit() drops.
+	// With FullPolicy::OverwriteOldest it's always the slot of the oldest element.
+	T* claim()
+	{
+		assert(m_claimed == 0);
+
+		if constexpr (Policy == FullPolicy::OverwriteOldest)
+		{
+			m_claimed = 1;
+			return _beginWrite(m_write_pos);
+		}
+		else if constexpr (Policy == FullPolicy::DropNewest)
+		{
+			if (_producerSeesFull())
+			{
+				_countFullStall();
+				m_claimed = 1;
+				m_claimed_scratch = true;
+				return &m_scratch;
+			}
+
+			m_claimed = 1;
+			return &m_buffer[m_head->load(std::memory_order_relaxed) & _mask()];
+		}
+
+		if (_producerSeesFull())
+		{
+			_countFullStall();
+			if (m_tracer != nullptr)
+				m_tracer->record(TraceOp::WaitFull, m_head->load(std::memory_order_relaxed), m_cached_tail);
+		}
+
+		if (m_not_full != nullptr)
+			waitFor(m_not_full, [this]() { return !_producerSeesFull(); });
+		else
+		{
+			while (_producerSeesFull())
+			{
+				// relinquish the current thread to the back of the queue
+				// allow other threads even on other processes to execute, so more chance that reader process will read something from the queue.
+				sched_yield();
+			}
+		}
+
+		m_claimed = 1;
+		return &m_buffer[m_head->load(std::memory_order_relaxed) & _mask()];
+	}
+
+	// Claim up to 'n' free slots without blocking, return them as up to two spans (empty if ring is full).
+	// Producer fills them in place, then publishes with commit().
+	SlotSpans<T> claim(std::size_t n)
+	{
+		assert(m_claimed == 0);
+
+		if constexpr (Policy == FullPolicy::OverwriteOldest)
+		{
+			n = std::min(n, capacity());
+			for (std::size_t i=0; i<n; ++i)
+				_beginWrite(m_write_pos + i);
+
+			const std::size_t head = m_write_pos & _mask();
+			const std::size_t first = std::min(n, capacity() - head);
+			m_claimed = n;
+			return { std::span<T>(m_buffer + head, first), std::span<T>(m_buffer, n - first) };
+		}
+
+		const std::uint64_t head = m_head->load(std::memory_order_relaxed);
+		const std::size_t wanted = n;
+		n = std::min(_freeSlots(head, n), n);
+		if (n == 0 && wanted != 0)
+			_countFullStall();
+
+		const std::size_t idx = head & _mask();
+		const std::size_t first = std::min(n, capacity() - idx);
+		m_claimed = n;
+		return { std::span<T>(m_buffer + idx, first), std::span<T>(m_buffer, n - first) };
+	}
+
+	// Publish the first 'n' claimed slots with a single store of head, any remaining claimed slot is given back.
+	// With FullPolicy::OverwriteOldest, elements of the remaining slots are gone, consumer skips them as overwritten.
+	void commit(std::size_t n)
+	{
+		assert(n <= m_claimed);
+		m_claimed = 0;
+
+		if (m_claimed_scratch)
+		{
+			m_claimed_scratch = false;
+			_count(m_dropped, n);
+			return;
+		}
+
+		if (n == 0)
+			return;
+
+		if constexpr (Policy == FullPolicy::OverwriteOldest)
+		{
+			for (std::size_t i=0; i<n; ++i)
+				_endWrite(m_write_pos + i);
+			m_write_pos += n;
+			_publishHead(n);
+			return;
+		}
+
+		const std::uint64_t head = m_head->load(std::memory_order_relaxed);
+		m_head->store(head + n, std::memory_order_release);
+		_notifyNotEmpty();
+		_countPublish(n);
+		_trace(TraceOp::Put, head + n, m_cached_tail);
+	}
+
+	// Publish all claimed slots
+	void commit()
+	{
+		commit(m_claimed);
+	}
 
 private:
-    ElementData* m_buffer = nullptr;
-	const int m_buffer_size = 0;
-	std::atomic<int>* m_head = nullptr;
-	std::atomic<int>* m_tail = nullptr;
+	T* m_buffer = nullptr;
+	std::atomic<std::uint64_t>* m_head = nullptr;
+	std::atomic<std::uint64_t>* m_tail = nullptr;
+
+	// optional, see constructor
+	FutexWaitWord* m_not_empty = nullptr;
+	FutexWaitWord* m_not_full = nullptr;
+
+	// process-local view of the other side's index, see IndexCaching::Local
+	std::uint64_t m_cached_head = 0;
+	std::uint64_t m_cached_tail = 0;
+
+	// only used with sDynamicCapacity
+	std::size_t m_mask = sMask;
+
+	// optional, see setTracer()
+	Tracer* m_tracer = nullptr;
+
+	// optional, see setEventFd()
+	int m_event_fd = -1;
+	std::atomic<std::uint32_t>* m_consumer_sleeping = nullptr;
+
+	// optional, see constructor, FullPolicy::DropNewest counts into 'dropped', FullPolicy::OverwriteOldest
+	// into 'overwritten'
+	std::atomic<std::uint64_t>* m_dropped = nullptr;
+	std::atomic<std::uint64_t>* m_overwritten = nullptr;
+
+	// only used with FullPolicy::OverwriteOldest, producer's and consumer's own copies of head and tail
+	std::atomic<std::uint64_t>* m_slot_seqs = nullptr;
+	std::uint64_t m_write_pos = 0;
+	std::uint64_t m_read_pos = 0;
+
+	// optional, see constructor
+	ProducerStats* m_producer_stats = nullptr;
+	ConsumerStats* m_consumer_stats = nullptr;
+
+	// only used with FullPolicy::DropNewest, what claim() hands out when ring is full
+	T m_scratch;
+	bool m_claimed_scratch = false;
+
+	// number of slots handed out by claim() but not yet committed
+	std::size_t m_claimed = 0;
 };
+
+// the ring used by writer and reader, sized by the segment it lives in, see segment.h
+template <FullPolicy Policy>
+using PolicyRingBuffer = BasicRingBuffer<ElementData, sDynamicCapacity, IndexCaching::Local, Policy>;
+
+using RingBuffer = PolicyRingBuffer<FullPolicy::Block>;
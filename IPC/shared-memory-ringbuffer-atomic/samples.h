@@ -0,0 +1,130 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Binary time series of latency samples, for when a histogram (histogram.h) is not enough and every sample is wanted.
+//
+// Samples go as fixed-size records straight into a file mapped up front, preallocated and prefaulted, so recording one
+// is a couple of stores to memory: no formatting, no syscall, and the kernel writes pages back on its own. When the
+// file is full further samples are only counted. 'samples2csv' turns a file into the Timestamp,Latency CSV which
+// plotchart.R reads.
+namespace lib
+{
+
+// "OSIMSMP1"
+const std::uint64_t sSamplesMagic = 0x31504d534d49534full;
+const std::uint32_t sSamplesVersion = 1;
+
+struct LatencySample
+{
+	// steady clock, see steadyNowNs()
+	std::uint64_t timestamp_ns;
+	std::uint64_t latency_ns;
+	// of the element, to spot gaps and reordering
+	std::uint64_t seq;
+};
+
+struct SamplesHeader
+{
+	std::uint64_t magic;
+	std::uint32_t version;
+	std::uint32_t record_size;
+	std::uint64_t capacity;
+	// system clock minus steady clock when recording started, so timestamps can be turned into wall-clock time
+	std::int64_t realtime_offset_ns;
+	// written by recorder after every sample, so the file is readable even if it's killed
+	std::atomic<std::uint64_t> count;
+	std::atomic<std::uint64_t> dropped;
+};
+
+inline std::size_t samplesFileSize(std::size_t capacity)
+{
+	return sizeof(SamplesHeader) + capacity * sizeof(LatencySample);
+}
+
+// Single-threaded, owns the mapping of its file
+class SampleRecorder
+{
+public:
+	SampleRecorder(const char* path, std::size_t capacity) :
+		m_capacity(capacity),
+		m_size(samplesFileSize(capacity))
+	{
+		const int fd = open(path, O_CREAT | O_RDWR | O_TRUNC | O_CLOEXEC, 0644);
+		if (fd == -1)
+			throw std::runtime_error("Error: SampleRecorder can't open the file");
+
+		// fallocate() reserves the blocks, so a full disk fails here rather than as SIGBUS while recording
+		void* ptr = MAP_FAILED;
+		if (posix_fallocate(fd, 0, m_size) == 0)
+			ptr = mmap(0, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+		if (ptr == MAP_FAILED)
+			throw std::runtime_error("Error: SampleRecorder can't allocate or map the file");
+
+		// write faults up front, MAP_POPULATE would map pages read-only and the first store to each still faults
+		madvise(ptr, m_size, MADV_POPULATE_WRITE);
+
+		m_header = static_cast<SamplesHeader*>(ptr);
+		m_records = reinterpret_cast<LatencySample*>(m_header + 1);
+
+		const auto realtime = std::chrono::system_clock::now().time_since_epoch();
+		const auto steady = std::chrono::steady_clock::now().time_since_epoch();
+		m_header->magic = sSamplesMagic;
+		m_header->version = sSamplesVersion;
+		m_header->record_size = sizeof(LatencySample);
+		m_header->capacity = capacity;
+		m_header->realtime_offset_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(realtime - steady).count();
+		m_header->count.store(0, std::memory_order_relaxed);
+		m_header->dropped.store(0, std::memory_order_relaxed);
+	}
+
+	~SampleRecorder()
+	{
+		munmap(m_header, m_size);
+	}
+
+	void record(std::uint64_t timestamp_ns, std::uint64_t latency_ns, std::uint64_t seq)
+	{
+		if (m_count == m_capacity)
+		{
+			m_header->dropped.store(++m_dropped, std::memory_order_relaxed);
+			return;
+		}
+
+		m_records[m_count] = LatencySample{timestamp_ns, latency_ns, seq};
+		m_header->count.store(++m_count, std::memory_order_relaxed);
+	}
+
+	std::uint64_t count() const
+	{
+		return m_count;
+	}
+
+	std::uint64_t dropped() const
+	{
+		return m_dropped;
+	}
+
+private:
+	// disable copy-construct, and assignment operator
+	SampleRecorder(const SampleRecorder&);
+	SampleRecorder& operator=(const SampleRecorder&);
+
+	SamplesHeader* m_header = nullptr;
+	LatencySample* m_records = nullptr;
+	std::size_t m_capacity = 0;
+	std::size_t m_size = 0;
+	// process-local copies, header only gets stores
+	std::uint64_t m_count = 0;
+	std::uint64_t m_dropped = 0;
+};
+
+};
@@ -0,0 +1,79 @@
+/**
+ * Convert latency samples recorded by 'reader-bench --samples FILE' (see samples.h) into the Timestamp,Latency
+ * time series plotchart.R reads: Timestamp in ms since epoch, Latency in microseconds.
+ *
+ * Usage: ./samples2csv FILE > ts-input.txt
+ * then Rscript plotchart.R ts-input.txt chart.png
+ */
+#include <iostream>
+#include <iomanip>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdint>
+
+#include "lib.h"
+#include "samples.h"
+
+using namespace lib;
+
+int main(int argc, char* argv[])
+{
+	if (argc != 2)
+	{
+		std::cerr << "Usage: " << argv[0] << " FILE\n";
+		return 1;
+	}
+
+	const int fd = open(argv[1], O_RDONLY | O_CLOEXEC);
+	if (fd == -1)
+	{
+		std::cerr << "can't open " << argv[1] << "\n";
+		return 1;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(SamplesHeader))
+	{
+		std::cerr << argv[1] << " is too small to be a samples file\n";
+		close(fd);
+		return 1;
+	}
+
+	const std::size_t size = st.st_size;
+	void* ptr = mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (ptr == MAP_FAILED)
+	{
+		std::cerr << "mmap() failed\n";
+		return 1;
+	}
+
+	// for RAII
+	MMap mmap(ptr, size);
+
+	const SamplesHeader* header = static_cast<const SamplesHeader*>(ptr);
+	const std::uint64_t count = header->count.load(std::memory_order_relaxed);
+	if (header->magic != sSamplesMagic || header->version != sSamplesVersion || header->record_size != sizeof(LatencySample))
+	{
+		std::cerr << argv[1] << " is not a samples file of this version\n";
+		return 1;
+	}
+	if (count > header->capacity || size < samplesFileSize(count))
+	{
+		std::cerr << argv[1] << " is smaller than its header says\n";
+		return 1;
+	}
+
+	const LatencySample* records = reinterpret_cast<const LatencySample*>(header + 1);
+	std::cout << "Timestamp,Latency\n" << std::fixed << std::setprecision(3);
+	for (std::uint64_t i=0; i<count; ++i)
+	{
+		const std::int64_t realtime_ns = static_cast<std::int64_t>(records[i].timestamp_ns) + header->realtime_offset_ns;
+		std::cout << realtime_ns / 1000000 << "," << records[i].latency_ns / 1000.0 << "\n";
+	}
+
+	std::cerr << "samples: " << count << ", dropped when file was full: " << header->dropped.load(std::memory_order_relaxed) << "\n";
+	return 0;
+}
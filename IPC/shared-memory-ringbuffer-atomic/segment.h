@@ -0,0 +1,270 @@
+#pragma once
+
+#include <iostream>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <unistd.h>
+
+#include "lib.h"
+#include "affinity.h"
+#include "lastvalue.h"
+
+// Self-describing layout of the shared memory segment.
+//
+// Segment is SharedData (whose first member is SegmentHeader), followed by 'capacity' ElementData of RingBuffer and
+// then by their sequences, which only FullPolicy::OverwriteOldest uses, and by LastValueCache if writer keeps one:
+//
+//   [SegmentHeader | fixed part of SharedData ...][ElementData * capacity][sequence * capacity][entry * lvc_capacity]
+//   ^ 0                                            ^ data_offset           ^ seq_offset          ^ lvc_offset
+//
+// Writer decides name and capacity at runtime and fills in the header, readers validate it against what they were
+// compiled with before touching anything else, so a mismatched binary fails on attach instead of corrupting memory.
+namespace lib
+{
+
+// "OSIMHEN1"
+const std::uint64_t sSegmentMagic = 0x314e45484d49534full;
+// bump whenever layout of SharedData or of anything in it changes
+const std::uint32_t sLayoutVersion = 7;
+
+const char* const sDefaultSegmentName = "/osimhen";
+
+// Offset of per-slot sequences, on a cache line of their own
+inline std::size_t seqOffset(std::size_t capacity)
+{
+	return (sizeof(SharedData) + capacity * sizeof(ElementData) + 63) & ~std::size_t(63);
+}
+
+using LastValueEntryData = LastValueEntry<ElementData>;
+
+// Offset of LastValueCache entries, on a cache line of their own
+inline std::size_t lvcOffset(std::size_t capacity)
+{
+	return (seqOffset(capacity) + capacity * sizeof(std::atomic<std::uint64_t>) + 63) & ~std::size_t(63);
+}
+
+// Size of the whole segment for a RingBuffer of 'capacity' elements (0 unless RingKind is Spsc), and LastValueCache
+// of 'lvc_capacity' entries
+inline std::size_t segmentSize(std::size_t capacity, std::size_t lvc_capacity = 0)
+{
+	return lvcOffset(capacity) + lvc_capacity * sizeof(LastValueEntryData);
+}
+
+// Writer only, on a freshly sized segment before anyone attaches
+inline void initHeader(SharedData* ptr, std::size_t capacity, FullPolicy full_policy = FullPolicy::Block, std::size_t lvc_capacity = 0)
+{
+	SegmentHeader& header = ptr->header;
+	header.version = sLayoutVersion;
+	header.element_size = sizeof(ElementData);
+	header.capacity = capacity;
+	header.ctrl_offset = offsetof(SharedData, rb_ctrl_fields);
+	header.data_offset = sizeof(SharedData);
+	header.seq_offset = seqOffset(capacity);
+	header.segment_size = segmentSize(capacity, lvc_capacity);
+	header.full_policy = static_cast<std::uint32_t>(full_policy);
+	header.ring_kind = static_cast<std::uint32_t>(sRingKind);
+	header.lvc_capacity = lvc_capacity;
+	header.lvc_offset = lvcOffset(capacity);
+
+	// last, so whoever sees the magic sees the rest of header as well
+	header.magic.store(sSegmentMagic, std::memory_order_release);
+}
+
+// Reader side, return why the segment can't be used, or nullptr if it's fine.
+// 'mapped_size' is the size of the segment as reported by fstat().
+inline const char* checkHeader(const SharedData* ptr, std::size_t mapped_size)
+{
+	const SegmentHeader& header = ptr->header;
+	if (mapped_size < sizeof(SharedData))
+		return "segment is too small to be a ring segment";
+	if (header.magic.load(std::memory_order_acquire) != sSegmentMagic)
+		return "not a ring segment, or writer hasn't initialized it yet";
+	if (header.version != sLayoutVersion)
+		return "layout version differs from this binary";
+	if (header.element_size != sizeof(ElementData))
+		return "element size differs from this binary";
+	if (header.ring_kind != static_cast<std::uint32_t>(sRingKind))
+		return "writer is built for another kind of ring than this binary";
+	if (header.ctrl_offset != offsetof(SharedData, rb_ctrl_fields) || header.data_offset != sizeof(SharedData))
+		return "offsets of control or data region differ from this binary";
+	if (sRingKind != RingKind::Spsc && header.capacity != 0)
+		return "RingBuffer has capacity in a segment of another ring";
+	if (sRingKind == RingKind::Spsc && (header.capacity < 2 || (header.capacity & (header.capacity - 1)) != 0))
+		return "capacity is not power of two";
+	if (header.seq_offset != seqOffset(header.capacity))
+		return "offset of sequences differs from this binary";
+	if (header.full_policy > static_cast<std::uint32_t>(FullPolicy::OverwriteOldest))
+		return "unknown full policy";
+	if (header.lvc_capacity == 1 || (header.lvc_capacity & (header.lvc_capacity - 1)) != 0)
+		return "capacity of last-value cache is not power of two";
+	if (header.lvc_offset != lvcOffset(header.capacity))
+		return "offset of last-value cache differs from this binary";
+	if (header.segment_size != segmentSize(header.capacity, header.lvc_capacity) || header.segment_size > mapped_size)
+		return "segment is smaller than its header says";
+	return nullptr;
+}
+
+inline ElementData* ringElements(SharedData* ptr)
+{
+	return reinterpret_cast<ElementData*>(reinterpret_cast<std::byte*>(ptr) + ptr->header.data_offset);
+}
+
+inline std::atomic<std::uint64_t>* ringSlotSeqs(SharedData* ptr)
+{
+	return reinterpret_cast<std::atomic<std::uint64_t>*>(reinterpret_cast<std::byte*>(ptr) + ptr->header.seq_offset);
+}
+
+// nullptr if writer keeps no LastValueCache
+inline LastValueEntryData* lastValueEntries(SharedData* ptr)
+{
+	if (ptr->header.lvc_capacity == 0)
+		return nullptr;
+	return reinterpret_cast<LastValueEntryData*>(reinterpret_cast<std::byte*>(ptr) + ptr->header.lvc_offset);
+}
+
+// How the segment is backed and mapped
+struct MapOptions
+{
+	// back by huge pages from hugetlbfs (sHugetlbfsDir), falling back to normal pages when there are none
+	bool hugepages = false;
+	// fault every page in when mapping and mlock() them, so the first lap over the ring takes no page faults
+	bool prefault = false;
+	// NUMA node to take pages from, -1 leaves it to first touch. Only the one creating the segment sets it.
+	int numa_node = -1;
+	// map it PROT_READ, for observers which must never write to it. Only for attachSegment().
+	bool read_only = false;
+};
+
+// files on hugetlbfs are backed by huge pages
+const char* const sHugetlbfsDir = "/dev/hugepages";
+
+// Segment mapped into this process, caller owns 'fd' and 'ptr' through ShmFd/ShmFdClient and MMap
+struct Segment
+{
+	int fd = -1;
+	void* ptr = nullptr;
+	std::size_t size = 0;
+	// path of the file on hugetlbfs, empty for a shm_open() one
+	std::string file_path;
+};
+
+// Return nullptr on failure. With 'thp', transparent huge pages are asked for before anything is faulted in.
+inline void* mapSegment(int fd, std::size_t size, const MapOptions& opts, bool thp)
+{
+	// huge page advice and memory policy have to be in place before the first fault, so prefault after them
+	const bool populate_later = thp || opts.numa_node >= 0;
+	const int flags = MAP_SHARED_VALIDATE | (opts.prefault && !populate_later ? MAP_POPULATE : 0);
+	void* ptr = mmap(0, size, opts.read_only ? PROT_READ : PROT_READ | PROT_WRITE, flags, fd, 0);
+	if (ptr == MAP_FAILED)
+		return nullptr;
+
+	// only has effect if /sys/kernel/mm/transparent_hugepage/shmem_enabled allows it, so failure is fine
+	if (thp)
+		madvise(ptr, size, MADV_HUGEPAGE);
+
+	if (opts.numa_node >= 0 && !bindToNode(ptr, size, opts.numa_node))
+		std::cerr << "mbind() to node " << opts.numa_node << " failed, pages come from wherever they're first touched\n";
+
+	if (opts.prefault && populate_later && madvise(ptr, size, opts.read_only ? MADV_POPULATE_READ : MADV_POPULATE_WRITE) != 0)
+		std::cerr << "madvise(MADV_POPULATE_*) failed, pages will be faulted in on first touch\n";
+
+	if (opts.prefault && mlock(ptr, size) != 0)
+		std::cerr << "mlock() failed, segment may be paged out (see ulimit -l)\n";
+	return ptr;
+}
+
+// Writer side, create segment 'name' of at least 'size' bytes and map it. Return false on failure.
+inline bool createSegment(const char* name, std::size_t size, const MapOptions& opts, Segment& seg)
+{
+	if (opts.hugepages)
+	{
+		std::string path = std::string(sHugetlbfsDir) + name;
+		int fd = open(path.c_str(), O_CREAT | O_RDWR, 0666);
+		if (fd != -1)
+		{
+			// size of a file on hugetlbfs has to be multiple of huge page size, which is its block size
+			struct statfs fs;
+			const std::size_t huge_size = fstatfs(fd, &fs) == 0 ? fs.f_bsize : 2 * 1024 * 1024;
+			const std::size_t huge_rounded = (size + huge_size - 1) / huge_size * huge_size;
+
+			// mmap() fails here if not enough huge pages are reserved (vm.nr_hugepages)
+			void* ptr = nullptr;
+			if (ftruncate(fd, huge_rounded) == 0 && (ptr = mapSegment(fd, huge_rounded, opts, false)) != nullptr)
+			{
+				seg = Segment{fd, ptr, huge_rounded, std::move(path)};
+				return true;
+			}
+
+			close(fd);
+			unlink(path.c_str());
+		}
+		std::cerr << "huge pages on " << sHugetlbfsDir << " not available, falling back to normal pages\n";
+	}
+
+	int fd = shm_open(name, O_CREAT | O_RDWR, 0666);
+	if (fd == -1)
+	{
+		std::cerr << "shm_open() failed\n";
+		return false;
+	}
+
+	void* ptr = nullptr;
+	if (ftruncate(fd, size) != 0 || (ptr = mapSegment(fd, size, opts, opts.hugepages)) == nullptr)
+	{
+		std::cerr << "ftruncate() or mmap() failed\n";
+		close(fd);
+		shm_unlink(name);
+		return false;
+	}
+
+	seg = Segment{fd, ptr, size, {}};
+	return true;
+}
+
+// Reader side, map the segment writer created, wherever it lives and whatever size it has.
+// Return false on failure, header still has to be checked with checkHeader() (or ChannelDirectory::check()).
+inline bool attachSegment(const char* name, const MapOptions& opts, Segment& seg)
+{
+	std::string path;
+	const int oflag = opts.read_only ? O_RDONLY : O_RDWR;
+	int fd = shm_open(name, oflag, 0666);
+	if (fd == -1)
+	{
+		// writer may have put it on hugetlbfs
+		path = std::string(sHugetlbfsDir) + name;
+		fd = open(path.c_str(), oflag);
+		if (fd == -1)
+		{
+			std::cerr << "shm_open() failed\n";
+			return false;
+		}
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		std::cerr << "segment " << name << " is empty, writer hasn't sized it yet\n";
+		close(fd);
+		return false;
+	}
+
+	const std::size_t size = st.st_size;
+	void* ptr = mapSegment(fd, size, opts, false);
+	if (ptr == nullptr)
+	{
+		std::cerr << "mmap() failed\n";
+		close(fd);
+		return false;
+	}
+
+	seg = Segment{fd, ptr, size, std::move(path)};
+	return true;
+}
+
+};
@@ -0,0 +1,239 @@
+/**
+ * Live counters of running rings, read from their shared memory segment, see ProducerStats and ConsumerStats.
+ * It attaches read-only and only loads counters which each side keeps on a cache line of its own, so it never
+ * slows down or disturbs the rings it watches.
+ *
+ * Prints a line per ring every interval: capacity, occupancy (head - tail) and the most consumer has seen, rates of
+ * puts and gets, mean batch of each side, how often producer found the ring full and consumer found it empty, and
+ * rates of dropped and overwritten elements. A producer stalling on full points at a slow consumer, a consumer
+ * polling empty at a slow producer.
+ * A channel segment is recognized by its header, and every channel in it gets a line.
+ *
+ * Usage: ./shmstat [--name /name] [--interval ms] [--count N]
+ * --name is the segment to watch (default /osimhen), --interval is in ms (default 1000). It keeps printing until
+ * Ctrl+C, writer terminating, or --count intervals.
+ */
+#include <iostream>
+#include <iomanip>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <csignal>
+#include <cstdint>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "lib.h"
+#include "segment.h"
+#include "channel.h"
+
+using namespace lib;
+
+static volatile std::sig_atomic_t s_still_operate = 1;
+
+void signal_handler(int)
+{
+	s_still_operate = 0;
+}
+
+namespace
+{
+
+struct Ring
+{
+	std::string name;
+	std::uint64_t capacity;
+	const RingBufferCtrlFields* ctrl;
+};
+
+// Counters of a ring at one point in time
+struct Sample
+{
+	std::uint64_t puts = 0;
+	std::uint64_t publishes = 0;
+	std::uint64_t full_stalls = 0;
+	std::uint64_t gets = 0;
+	std::uint64_t releases = 0;
+	std::uint64_t empty_polls = 0;
+	std::uint64_t dropped = 0;
+	std::uint64_t overwritten = 0;
+};
+
+Sample sample(const RingBufferCtrlFields& ctrl)
+{
+	Sample s;
+	s.puts = ctrl.producer_stats.puts.load(std::memory_order_relaxed);
+	s.publishes = ctrl.producer_stats.publishes.load(std::memory_order_relaxed);
+	s.full_stalls = ctrl.producer_stats.full_stalls.load(std::memory_order_relaxed);
+	s.gets = ctrl.consumer_stats.gets.load(std::memory_order_relaxed);
+	s.releases = ctrl.consumer_stats.releases.load(std::memory_order_relaxed);
+	s.empty_polls = ctrl.consumer_stats.empty_polls.load(std::memory_order_relaxed);
+	s.dropped = ctrl.dropped.load(std::memory_order_relaxed);
+	s.overwritten = ctrl.overwritten.load(std::memory_order_relaxed);
+	return s;
+}
+
+void printHeader()
+{
+	std::cout << std::left << std::setw(16) << "ring" << std::right
+		<< std::setw(10) << "capacity"
+		<< std::setw(10) << "occupancy"
+		<< std::setw(10) << "max occ"
+		<< std::setw(12) << "puts/s"
+		<< std::setw(12) << "gets/s"
+		<< std::setw(10) << "put batch"
+		<< std::setw(10) << "get batch"
+		<< std::setw(10) << "full/s"
+		<< std::setw(12) << "empty/s"
+		<< std::setw(11) << "dropped/s"
+		<< std::setw(14) << "overwritten/s" << "\n";
+}
+
+void printRing(const Ring& ring, const Sample& prev, const Sample& cur, double seconds)
+{
+	const RingBufferCtrlFields& ctrl = *ring.ctrl;
+	// tail first, so it's never past head
+	const std::uint64_t tail = ctrl.tail.load(std::memory_order_acquire);
+	const std::uint64_t head = ctrl.head.load(std::memory_order_acquire);
+
+	auto rate = [seconds](std::uint64_t from, std::uint64_t to) {
+		return static_cast<std::uint64_t>((to - from) / seconds);
+	};
+	auto batch = [](std::uint64_t elements, std::uint64_t stores) {
+		return stores == 0 ? 0.0 : static_cast<double>(elements) / stores;
+	};
+
+	std::cout << std::left << std::setw(16) << ring.name << std::right
+		<< std::setw(10) << ring.capacity
+		<< std::setw(10) << head - tail
+		<< std::setw(10) << ctrl.consumer_stats.max_occupancy.load(std::memory_order_relaxed)
+		<< std::setw(12) << rate(prev.puts, cur.puts)
+		<< std::setw(12) << rate(prev.gets, cur.gets)
+		<< std::fixed << std::setprecision(1)
+		<< std::setw(10) << batch(cur.puts - prev.puts, cur.publishes - prev.publishes)
+		<< std::setw(10) << batch(cur.gets - prev.gets, cur.releases - prev.releases)
+		<< std::setw(10) << rate(prev.full_stalls, cur.full_stalls)
+		<< std::setw(12) << rate(prev.empty_polls, cur.empty_polls)
+		<< std::setw(11) << rate(prev.dropped, cur.dropped)
+		<< std::setw(14) << rate(prev.overwritten, cur.overwritten) << "\n";
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+	std::signal(SIGINT, signal_handler);
+	std::signal(SIGTERM, signal_handler);
+
+	const char* name = sDefaultSegmentName;
+	long interval_ms = 1000;
+	long count = -1;
+	for (int i=1; i<argc; ++i)
+	{
+		const std::string_view arg(argv[i]);
+		if (arg == "--name" && i + 1 < argc)
+			name = argv[++i];
+		else if (arg == "--interval" && i + 1 < argc)
+			interval_ms = std::max(1L, std::atol(argv[++i]));
+		else if (arg == "--count" && i + 1 < argc)
+			count = std::atol(argv[++i]);
+		else
+		{
+			std::cerr << "Usage: " << argv[0] << " [--name /name] [--interval ms] [--count N]\n";
+			return 1;
+		}
+	}
+
+	MapOptions map_opts;
+	map_opts.read_only = true;
+	Segment segment;
+	if (!attachSegment(name, map_opts, segment))
+		return 1;
+
+	// for RAII
+	ShmFdClient shm_fd_obj(segment.fd, name);
+	MMap mmap(segment.ptr, segment.size);
+
+	// both kinds of segment start with their magic
+	const std::byte* base = static_cast<const std::byte*>(segment.ptr);
+	const std::atomic<bool>* operational = nullptr;
+	std::vector<Ring> rings;
+	if (segment.size >= sizeof(ChannelDirectoryHeader) && reinterpret_cast<const ChannelDirectoryHeader*>(base)->magic.load(std::memory_order_acquire) == sChannelMagic)
+	{
+		ChannelDirectory dir(segment.ptr, segment.size);
+		if (const char* reason = dir.check())
+		{
+			std::cerr << "segment " << name << " can't be used: " << reason << "\n";
+			return 1;
+		}
+
+		for (const ChannelEntry* entry : dir.channels())
+		{
+			if (const char* reason = dir.checkEntry(*entry))
+			{
+				std::cerr << "channel " << entry->name << " in " << name << " can't be used: " << reason << "\n";
+				return 1;
+			}
+			rings.push_back({ entry->name, entry->capacity, reinterpret_cast<const RingBufferCtrlFields*>(base + entry->ctrl_offset) });
+		}
+		operational = &dir.header()->operational;
+	}
+	else
+	{
+		const SharedData* ptr = static_cast<const SharedData*>(segment.ptr);
+		if (const char* reason = checkHeader(ptr, segment.size))
+		{
+			std::cerr << "segment " << name << " can't be used: " << reason << "\n";
+			return 1;
+		}
+
+		rings.push_back({ name, ptr->header.capacity, &ptr->rb_ctrl_fields });
+		operational = &ptr->operational;
+	}
+
+	std::vector<Sample> prev;
+	for (const Ring& ring : rings)
+		prev.push_back(sample(*ring.ctrl));
+	auto prev_time = std::chrono::steady_clock::now();
+
+	printHeader();
+	bool seen_operational = false;
+	while (s_still_operate && count != 0)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+		if (!s_still_operate)
+			break;
+
+		const auto now = std::chrono::steady_clock::now();
+		const double seconds = std::chrono::duration<double>(now - prev_time).count();
+		prev_time = now;
+
+		for (std::size_t i=0; i<rings.size(); ++i)
+		{
+			const Sample cur = sample(*rings[i].ctrl);
+			printRing(rings[i], prev[i], cur, seconds);
+			prev[i] = cur;
+		}
+		if (rings.size() > 1)
+			std::cout << "\n";
+		std::cout << std::flush;
+
+		if (count > 0)
+			--count;
+
+		// writer only raises it after its first put
+		const bool is_operational = operational->load(std::memory_order_acquire);
+		if (seen_operational && !is_operational)
+		{
+			std::cerr << "writer has terminated\n";
+			break;
+		}
+		seen_operational = seen_operational || is_operational;
+	}
+
+	return 0;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <unistd.h>
+
+// Opt-in binary trace of ring operations.
+//
+// Events go into their own shared memory segment (sTraceName) as fixed-size records, so tracing never does I/O on
+// the hot path. Recording is lock-free and never blocks, when nobody drains fast enough the oldest events are
+// overwritten. 'tracedump' attaches read-only, drains and decodes them.
+namespace lib
+{
+
+const char* const sTraceName = "/osimhen-trace";
+// has to be power of two
+const std::size_t sTraceCapacity = 1 << 16;
+
+enum class TraceOp : std::uint32_t
+{
+	// producer published element(s)
+	Put = 1,
+	// consumer handed slot(s) back
+	Get,
+	// producer found ring full and is about to wait
+	WaitFull
+};
+
+inline const char* traceOpName(std::uint32_t op)
+{
+	switch (static_cast<TraceOp>(op))
+	{
+		case TraceOp::Put: return "put";
+		case TraceOp::Get: return "get";
+		case TraceOp::WaitFull: return "wait-full";
+	}
+	return "unknown";
+}
+
+// Fields are written and read as relaxed atomics, 'seq' tells reader whether the record is complete.
+// It's 0 while being written, and index of the event + 1 once complete.
+struct TraceEvent
+{
+	std::atomic<std::uint64_t> seq;
+	std::atomic<std::uint64_t> timestamp_ns;
+	// indices as seen by the recording side, the other side's one may be its cached view
+	std::atomic<std::uint64_t> head;
+	std::atomic<std::uint64_t> tail;
+	std::atomic<std::uint32_t> op;
+	std::atomic<std::uint32_t> pid;
+};
+
+struct TraceShared
+{
+	// index of the next event to be recorded, shared by all recording processes
+	alignas(64) std::atomic<std::uint64_t> next;
+	alignas(64) TraceEvent events[sTraceCapacity];
+};
+
+class Tracer
+{
+public:
+	Tracer(TraceShared* shared_ptr) :
+		m_shared(shared_ptr),
+		m_pid(static_cast<std::uint32_t>(getpid()))
+	{
+	}
+
+	void record(TraceOp op, std::uint64_t head, std::uint64_t tail)
+	{
+		const std::uint64_t idx = m_shared->next.fetch_add(1, std::memory_order_relaxed);
+		TraceEvent& ev = m_shared->events[idx & (sTraceCapacity - 1)];
+
+		// mark incomplete first, so reader won't take a half-overwritten record as the old one
+		ev.seq.store(0, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		ev.timestamp_ns.store(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(), std::memory_order_relaxed);
+		ev.head.store(head, std::memory_order_relaxed);
+		ev.tail.store(tail, std::memory_order_relaxed);
+		ev.op.store(static_cast<std::uint32_t>(op), std::memory_order_relaxed);
+		ev.pid.store(m_pid, std::memory_order_relaxed);
+
+		ev.seq.store(idx + 1, std::memory_order_release);
+	}
+
+private:
+	TraceShared* m_shared = nullptr;
+	std::uint32_t m_pid = 0;
+};
+
+};
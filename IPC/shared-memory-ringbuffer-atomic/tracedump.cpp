@@ -0,0 +1,120 @@
+/**
+ * Drain and decode the trace segment written by 'writer --trace' and 'reader --trace'.
+ * It attaches read-only, so it never slows down or disturbs the traced processes.
+ *
+ * Prints one event per line as "timestamp_ns pid op head tail", and keeps following new events until Ctrl+C.
+ * When it falls more than a whole trace buffer behind, the overwritten events are counted as dropped.
+ *
+ * Usage: ./tracedump [--from-start]
+ * By default only events recorded after attaching are printed, --from-start also prints what is still in the buffer.
+ */
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <csignal>
+#include <cstdint>
+#include <chrono>
+#include <thread>
+#include <string_view>
+
+#include "lib.h"
+#include "trace.h"
+
+using namespace lib;
+
+static volatile std::sig_atomic_t s_still_operate = 1;
+
+void signal_handler(int signal)
+{
+	s_still_operate = 0;
+}
+
+int main(int argc, char* argv[])
+{
+	std::signal(SIGINT, signal_handler);
+	std::signal(SIGTERM, signal_handler);
+
+	const bool from_start = argc > 1 && std::string_view(argv[1]) == "--from-start";
+
+	int trace_fd = shm_open(sTraceName, O_RDONLY, 0666);
+	if (trace_fd == -1)
+	{
+		std::cerr << "shm_open() failed, is writer running with --trace?\n";
+		return 1;
+	}
+
+	// for RAII
+	ShmFdClient shm_fd_obj(trace_fd, sTraceName);
+
+	const TraceShared* ptr = static_cast<const TraceShared*>(mmap(0, sizeof(TraceShared), PROT_READ, MAP_SHARED, trace_fd, 0));
+	if (ptr == MAP_FAILED)
+	{
+		std::cerr << "mmap() failed\n";
+		return 1;
+	}
+
+	// for RAII
+	MMap mmap(const_cast<TraceShared*>(ptr), sizeof(TraceShared));
+
+	std::uint64_t cursor = ptr->next.load(std::memory_order_acquire);
+	if (from_start)
+		cursor = cursor > sTraceCapacity ? cursor - sTraceCapacity : 0;
+
+	std::uint64_t dropped = 0;
+	while (s_still_operate)
+	{
+		const std::uint64_t next = ptr->next.load(std::memory_order_acquire);
+		if (cursor == next)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			continue;
+		}
+
+		// lapped, whatever is older than one buffer is gone already
+		if (next - cursor > sTraceCapacity)
+		{
+			dropped += next - sTraceCapacity - cursor;
+			cursor = next - sTraceCapacity;
+		}
+
+		const TraceEvent& ev = ptr->events[cursor & (sTraceCapacity - 1)];
+		const std::uint64_t seq = ev.seq.load(std::memory_order_acquire);
+		if (seq != cursor + 1)
+		{
+			// still being written, or already overwritten by a newer one
+			if (seq > cursor + 1)
+			{
+				++dropped;
+				++cursor;
+			}
+			else
+				std::this_thread::yield();
+			continue;
+		}
+
+		const std::uint64_t timestamp_ns = ev.timestamp_ns.load(std::memory_order_relaxed);
+		const std::uint64_t head = ev.head.load(std::memory_order_relaxed);
+		const std::uint64_t tail = ev.tail.load(std::memory_order_relaxed);
+		const std::uint32_t op = ev.op.load(std::memory_order_relaxed);
+		const std::uint32_t pid = ev.pid.load(std::memory_order_relaxed);
+
+		// copy is only valid if nobody started to overwrite the record meanwhile
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (ev.seq.load(std::memory_order_relaxed) != seq)
+		{
+			++dropped;
+			++cursor;
+			continue;
+		}
+
+		std::cout << timestamp_ns << " " << pid << " " << traceOpName(op) << " " << head << " " << tail << "\n";
+		++cursor;
+	}
+
+	std::cout << std::flush;
+	std::cerr << "dropped events: " << dropped << "\n";
+
+	return 0;
+}
@@ -3,6 +3,19 @@
  * Each iteration will delay some short duration of time in ms.
  * User can quit the writer process by pressing Ctrl+C then it will clear resource as well as setting
  * 'operional' data member of SharedData to notify other processes that it has terminated.
+ *
+ * Usage: ./writer [--name /name] [--capacity N] [--hugepages] [--prefault] [--cpus LIST] [--numa-node N] [--eventfd] [--lvc N] [--keys K] [--trace]
+ * --name is the shared memory segment to create (default /osimhen), and --capacity the number of RingBuffer
+ * elements in it (power of two, default 512). Readers learn both from the segment header.
+ * --hugepages backs the segment with huge pages from hugetlbfs if there are any, --prefault faults it in and locks it.
+ * --cpus pins writer to CPUs in taskset format (ex. 0,2-3), --numa-node takes the segment's pages from that node only.
+ * --eventfd hands out an eventfd to 'reader --epoll' over a Unix socket, and signals it when reader sleeps.
+ * --lvc keeps the latest element of every id in a LastValueCache of N entries (power of two) next to the ring, for
+ * 'reader --lvc'. --keys makes ids repeat, cycling through K of them, as updates of K instruments would.
+ * --trace records every ring operation into a separate shared memory segment, see 'tracedump'.
+ *
+ * Built with USE_DROP_NEWEST (USE_OVERWRITE), writer never waits for reader, a full ring drops the new element
+ * (overwrites the oldest one) instead. See FullPolicy.
  */
 #include <iostream>
 #include <fcntl.h>
@@ -15,18 +28,39 @@
 #include <csignal>
 #include <chrono>
 #include <random>
+#include <string>
+#include <memory>
 
 #include "lib.h"
 #include "ringbuffer.h"
+#include "mpmc_ringbuffer.h"
+#include "broadcast_ringbuffer.h"
+#include "byte_ringbuffer.h"
+#include "trace.h"
+#include "segment.h"
+#include "affinity.h"
+#include "eventfd.h"
+#include "lastvalue.h"
 
 using namespace lib;
 
+#if defined(USE_OVERWRITE)
+const FullPolicy sFullPolicy = FullPolicy::OverwriteOldest;
+#elif defined(USE_DROP_NEWEST)
+const FullPolicy sFullPolicy = FullPolicy::DropNewest;
+#else
+const FullPolicy sFullPolicy = FullPolicy::Block;
+#endif
+
 static bool s_still_operate = true;
 
 ShmFd* s_shm_fd_obj = nullptr;
 MMap* s_mmap = nullptr;
 SharedData* s_ptr = nullptr;
 
+ShmFd* s_trace_shm_fd_obj = nullptr;
+MMap* s_trace_mmap = nullptr;
+
 // shared memory won't be unlinked automatically and it still exists on the machine if signal comes
 // so we handle them here.
 void signal_handler(int signal)
@@ -58,11 +92,17 @@ void signal_handler(int signal)
 	if (s_mmap != nullptr)
 		MMap stack_value2 = *s_mmap;
 
+	if (s_trace_shm_fd_obj != nullptr)
+		ShmFd stack_value3 = *s_trace_shm_fd_obj;
+
+	if (s_trace_mmap != nullptr)
+		MMap stack_value4 = *s_trace_mmap;
+
 	// force exit to avoid double destructor call otherwise it will return back to normal flow within main()
 	std::exit(1);
 }
 
-int main()
+int main(int argc, char* argv[])
 {
 	std::signal(SIGINT, signal_handler);
 	std::signal(SIGTERM, signal_handler);
@@ -73,36 +113,95 @@ int main()
 	std::uniform_int_distribution<> dis(20, 40);
 
 	// recommended to use slash prefixed from manpage
-	const char* name = "/osimhen";
-	const int SIZE = sizeof(SharedData);
+	const char* name = sDefaultSegmentName;
+	std::size_t capacity = sElementSize;
+	bool trace = false;
+	bool use_eventfd = false;
+	MapOptions map_opts;
+	const char* cpu_list = nullptr;
+	std::size_t lvc_capacity = 0;
+	int keys = 0;
+	for (int i=1; i<argc; ++i)
+	{
+		const std::string_view arg(argv[i]);
+		if (arg == "--trace")
+			trace = true;
+		else if (arg == "--eventfd")
+			use_eventfd = true;
+		else if (arg == "--hugepages")
+			map_opts.hugepages = true;
+		else if (arg == "--prefault")
+			map_opts.prefault = true;
+		else if (arg == "--name" && i + 1 < argc)
+			name = argv[++i];
+		else if (arg == "--capacity" && i + 1 < argc)
+			capacity = std::strtoull(argv[++i], nullptr, 10);
+		else if (arg == "--cpus" && i + 1 < argc)
+			cpu_list = argv[++i];
+		else if (arg == "--numa-node" && i + 1 < argc)
+			map_opts.numa_node = std::atoi(argv[++i]);
+		else if (arg == "--lvc" && i + 1 < argc)
+			lvc_capacity = std::strtoull(argv[++i], nullptr, 10);
+		else if (arg == "--keys" && i + 1 < argc)
+			keys = std::atoi(argv[++i]);
+		else
+		{
+			std::cerr << "Usage: " << argv[0] << " [--name /name] [--capacity N] [--hugepages] [--prefault] [--cpus LIST] [--numa-node N] [--eventfd] [--lvc N] [--keys K] [--trace]\n";
+			return 1;
+		}
+	}
 
-	int shm_fd = shm_open(name, O_CREAT | O_RDWR, 0666);
-	if (shm_fd == -1)
+#if defined(USE_MPMC) || defined(USE_BROADCAST) || defined(USE_BYTES)
+	// the ring of this build has its size fixed in SharedData, so there are no RingBuffer elements to allocate
+	if (capacity != sElementSize)
+		std::cerr << "--capacity is only supported by RingBuffer, ignored\n";
+	capacity = 0;
+#else
+	if (capacity < 2 || (capacity & (capacity - 1)) != 0 || capacity > (1u << 30))
 	{
-		std::cerr << "shm_open() failed\n";
+		std::cerr << "capacity must be power of two, up to 2^30\n";
 		return 1;
 	}
+#endif
 
-	if (ftruncate(shm_fd, SIZE) != 0)
-		std::cerr << "ftruncate error\n";
-
-	// for RAII obj
-	ShmFd shm_fd_obj(shm_fd, name);
-	s_shm_fd_obj = &shm_fd_obj;
-
-	SharedData *ptr = static_cast<SharedData*>(mmap(0, SIZE, PROT_READ | PROT_WRITE, MAP_SHARED_VALIDATE, shm_fd, 0));
-	if (ptr == MAP_FAILED)
+	if (lvc_capacity == 1 || (lvc_capacity & (lvc_capacity - 1)) != 0 || lvc_capacity > (1u << 20))
 	{
-		std::cerr << "mmap() failed\n";
+		std::cerr << "last-value cache capacity must be power of two, up to 2^20\n";
 		return 1;
 	}
 
+	// pinned before the segment is created, so pages prefaulted without --numa-node are local to writer's CPUs
+	if (cpu_list != nullptr)
+	{
+		cpu_set_t cpus;
+		if (!parseCpuList(cpu_list, cpus))
+		{
+			std::cerr << "invalid CPU list " << cpu_list << "\n";
+			return 1;
+		}
+		if (!pinToCpus(cpus))
+			return 1;
+	}
+
+	Segment segment;
+	if (!createSegment(name, segmentSize(capacity, lvc_capacity), map_opts, segment))
+		return 1;
+
+	// for RAII obj
+	const bool is_file = !segment.file_path.empty();
+	ShmFd shm_fd_obj(segment.fd, is_file ? std::string_view(segment.file_path) : std::string_view(name), is_file);
+	s_shm_fd_obj = &shm_fd_obj;
+
+	SharedData *ptr = static_cast<SharedData*>(segment.ptr);
 	s_ptr = ptr;
 
 	// for RAII obj
-	MMap mmap(ptr, SIZE);
+	MMap mmap(ptr, segment.size);
 	s_mmap = &mmap;
 
+	// readers validate the layout against it before using anything else
+	initHeader(ptr, capacity, sFullPolicy, lvc_capacity);
+
 	// initialize rwlock for SharedData's control fields
 	//{
 	//	pthread_rwlockattr_t attr;
@@ -119,7 +218,84 @@ int main()
 	//	pthread_rwlock_init(&ptr->rb_ctrl_fields.rwlock, &attr);
 	//}
 
-	RingBuffer rb(ptr->elems, sElementSize, &ptr->rb_ctrl_fields.head, &ptr->rb_ctrl_fields.tail);
+#if defined(USE_MPMC)
+	// writer creates the segment, so it's the one to initialize slots
+	MPMCRingBuffer<ElementData, sElementSize> rb(ptr->mpmc_elems, &ptr->mpmc_ctrl_fields);
+	rb.init();
+#elif defined(USE_BROADCAST)
+	BroadcastWriter<ElementData, sElementSize> rb(&ptr->bcast_data, ptr->bcast_ctrl_fields.cursors);
+	rb.init();
+#elif defined(USE_BYTES)
+	ByteRingBuffer<sByteRingSize> rb(ptr->bytes, &ptr->bytes_ctrl_fields);
+#else
+	PolicyRingBuffer<sFullPolicy> rb(ringElements(ptr), ringSlotSeqs(ptr), capacity, &ptr->rb_ctrl_fields);
+#endif
+#if defined(USE_MPMC) || defined(USE_BROADCAST) || defined(USE_BYTES)
+	if (trace || use_eventfd)
+		std::cerr << "--trace and --eventfd are only supported by RingBuffer, ignored\n";
+#endif
+#if defined(USE_BYTES)
+	// records are plain text, there are no ids for the last-value cache to key on
+	if (keys != 0)
+		std::cerr << "--keys is not supported by ByteRingBuffer, ignored\n";
+#endif
+#if !defined(USE_MPMC) && !defined(USE_BROADCAST) && !defined(USE_BYTES)
+	// readers connect and get it whenever they like, even while ring is full, so it's served from a thread of its own
+	UniqueFd event_fd(use_eventfd ? createEventFd() : -1);
+	std::unique_ptr<EventFdServer> event_fd_server;
+	if (use_eventfd)
+	{
+		if (event_fd.get() == -1)
+		{
+			std::cerr << "eventfd() failed\n";
+			return 1;
+		}
+		event_fd_server = std::make_unique<EventFdServer>(name, event_fd.get());
+		rb.setEventFd(event_fd.get());
+	}
+
+	// trace segment lives on its own, so it doesn't change layout of SharedData
+	int trace_fd = -1;
+	if (trace)
+	{
+		trace_fd = shm_open(sTraceName, O_CREAT | O_RDWR, 0666);
+		if (trace_fd == -1)
+		{
+			std::cerr << "shm_open() failed for trace\n";
+			return 1;
+		}
+		if (ftruncate(trace_fd, sizeof(TraceShared)) != 0)
+			std::cerr << "ftruncate error for trace\n";
+	}
+
+	// for RAII obj, both are no-op when tracing is off
+	ShmFd trace_shm_fd_obj(trace_fd, sTraceName);
+	s_trace_shm_fd_obj = &trace_shm_fd_obj;
+
+	TraceShared* trace_ptr = nullptr;
+	if (trace)
+	{
+		trace_ptr = static_cast<TraceShared*>(::mmap(0, sizeof(TraceShared), PROT_READ | PROT_WRITE, MAP_SHARED_VALIDATE, trace_fd, 0));
+		if (trace_ptr == MAP_FAILED)
+		{
+			std::cerr << "mmap() failed for trace\n";
+			return 1;
+		}
+	}
+
+	MMap trace_mmap(trace_ptr, sizeof(TraceShared));
+	s_trace_mmap = &trace_mmap;
+
+	Tracer tracer(trace_ptr);
+	if (trace)
+		rb.setTracer(&tracer);
+#endif
+
+	// entries of a fresh segment are zero-filled, which is an empty cache
+	std::unique_ptr<LastValueCache<ElementData>> lvc;
+	if (lvc_capacity != 0)
+		lvc = std::make_unique<LastValueCache<ElementData>>(lastValueEntries(ptr), lvc_capacity);
+	bool lvc_full = false;
 
 	int increment_id = 0;
 	while (s_still_operate)
@@ -129,18 +305,43 @@ int main()
 		if (!s_still_operate)
 			break;
 
+		const char* message = "hello world";
+
+#if defined(USE_MPMC) || defined(USE_BROADCAST)
 		// prepare ElementData
 		ElementData elem_data;
-		elem_data.id = increment_id++;
-		const char* message = "hello world";
+		elem_data.id = keys > 0 ? increment_id++ % keys : increment_id++;
 		std::strcpy(elem_data.name, message);
 
 		if (!s_still_operate)
 			break;
 
+		elem_data.sent_ns = steadyNowNs();
 		rb.put(elem_data);
-		rb.printAllElements();
-		std::cout << "---------" << std::endl;
+		const ElementData* latest = &elem_data;
+#elif defined(USE_BYTES)
+		// record takes exactly the length of the text, no fixed-size slot
+		std::string text = "ID: " + std::to_string(increment_id++) + ", Name: " + message;
+		while (!rb.tryWrite(std::as_bytes(std::span(text))))
+			sched_yield();
+		// there is no ElementData to cache
+		const ElementData* latest = nullptr;
+#else
+		// prepare ElementData straight in the slot of shared memory, then publish it
+		ElementData* elem_data = rb.claim();
+		elem_data->id = keys > 0 ? increment_id++ % keys : increment_id++;
+		std::strcpy(elem_data->name, message);
+		elem_data->sent_ns = steadyNowNs();
+		rb.commit();
+		// only writer ever writes the slot, so it's still ours to read
+		const ElementData* latest = elem_data;
+#endif
+
+		if (lvc && latest != nullptr && !lvc->update(latest->id, *latest) && !lvc_full)
+		{
+			lvc_full = true;
+			std::cerr << "last-value cache is full, new ids such as " << latest->id << " are not cached\n";
+		}
 
 		if (!ptr->operational.load(std::memory_order_acquire))
 		{
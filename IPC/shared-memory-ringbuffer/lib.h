@@ -6,14 +6,26 @@
 #include <cassert>
 #include <mutex>
 #include <type_traits>
+#include <chrono>
+#include <cstdint>
+
+#include "locks.h"
 
 namespace lib
 {
 
+// steady clock is system-wide on Linux (CLOCK_MONOTONIC), so timestamps are comparable across processes
+inline std::uint64_t steadyNowNs()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 struct ElementData
 {
 	char name[255];
 	int id;
+	// steadyNowNs() when writer published it, so reader can measure one-way latency
+	std::uint64_t sent_ns;
 
 	friend std::ostream& operator<<(std::ostream& os, const ElementData& obj)
 	{
@@ -24,11 +36,33 @@ struct ElementData
 
 struct RingBufferCtrlFields
 {
-	alignas(64) pthread_rwlock_t rwlock;
-	alignas(64) int head;
-	alignas(64) int tail;
+	// pthread_rwlock_t unless built with another lock, see locks.h
+	alignas(64) RingLock lock;
+	// free-running positions, they never wrap, see RingBuffer
+	alignas(64) std::uint64_t head;
+	alignas(64) std::uint64_t tail;
+	// consumer sleeps on 'not_empty' under 'wait_mutex' until producer has put something, see RingBuffer
+	alignas(64) pthread_mutex_t wait_mutex;
+	pthread_cond_t not_empty;
 };
 
+// Process-shared, by whoever creates the segment before anyone waits on it. Timeouts are on steady clock.
+inline void initRingWait(RingBufferCtrlFields* ctrl)
+{
+	pthread_mutexattr_t mutex_attr;
+	pthread_mutexattr_init(&mutex_attr);
+	pthread_mutexattr_setpshared(&mutex_attr, PTHREAD_PROCESS_SHARED);
+	pthread_mutex_init(&ctrl->wait_mutex, &mutex_attr);
+	pthread_mutexattr_destroy(&mutex_attr);
+
+	pthread_condattr_t cond_attr;
+	pthread_condattr_init(&cond_attr);
+	pthread_condattr_setpshared(&cond_attr, PTHREAD_PROCESS_SHARED);
+	pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&ctrl->not_empty, &cond_attr);
+	pthread_condattr_destroy(&cond_attr);
+}
+
 const int sElementSize = 500;
 struct SharedData
 {
@@ -0,0 +1,281 @@
+#pragma once
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <atomic>
+#include <bit>
+#include <new>
+#include <stdexcept>
+#include <cstdint>
+
+// Locks guarding RingBuffer's head and tail, picked at compile time.
+//
+// * pthread_rwlock_t (default) - readers share it, but every lock and unlock goes through glibc's state machine and
+// may end up in futex syscalls
+// * TicketLock (-DUSE_TICKET_LOCK) - fair spinlock, lock is one fetch_add, unlock one store
+// * MCSLock (-DUSE_MCS_LOCK) - fair queue lock, every waiter spins on its own cache line, so a release only disturbs
+// the next waiter
+//
+// All of them live in shared memory and work across processes. The spinlocks take shared and exclusive the same way,
+// ring's critical sections are a few loads and stores so sharing buys little. Each locker below is one side's handle
+// to the lock, it meets BasicLockable and SharedLockable so std::lock_guard and std::shared_lock take it.
+namespace lib
+{
+
+// spins with CPU pause before yielding, the lock holder may be waiting for this very CPU
+const int sLockSpinCount = 100;
+
+inline void cpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	asm volatile("yield" ::: "memory");
+#endif
+}
+
+// On a single CPU whoever we wait for can't run while we spin, so waiters yield straight away
+inline int lockSpinCount()
+{
+	static const int spins = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? sLockSpinCount : 0;
+	return spins;
+}
+
+// Ticket and MCS waiters wait for their own turn with it, spinning for a while and then yielding the CPU at every
+// check, so a preempted holder or next in line gets to run and the queue keeps moving
+class SpinBackoff
+{
+public:
+	void pause()
+	{
+		if (m_spins < lockSpinCount())
+		{
+			++m_spins;
+			cpuRelax();
+		}
+		else
+			sched_yield();
+	}
+
+private:
+	int m_spins = 0;
+};
+
+struct PthreadRWLocker
+{
+	explicit PthreadRWLocker(pthread_rwlock_t* rwlock) :
+		m_rwlock(rwlock)
+	{
+		if (rwlock == nullptr)
+			throw std::runtime_error("pthread_rwlock_t cannot be nullptr");
+	}
+
+	void lock()
+	{
+		if (pthread_rwlock_wrlock(m_rwlock) != 0)
+			throw std::runtime_error("Error: RWLock error in locking");
+	}
+
+	void unlock()
+	{
+		pthread_rwlock_unlock(m_rwlock);
+	}
+
+	void lock_shared()
+	{
+		if (pthread_rwlock_rdlock(m_rwlock) != 0)
+			throw std::runtime_error("Error: RWSharedLock error in locking");
+	}
+
+	void unlock_shared()
+	{
+		pthread_rwlock_unlock(m_rwlock);
+	}
+
+private:
+	pthread_rwlock_t* m_rwlock = nullptr;
+};
+
+// Whoever takes a ticket waits until it's served, so the lock goes in order of arrival.
+// Both counters wrap together, fine as long as there are fewer than 2^32 waiters.
+struct TicketLock
+{
+	alignas(64) std::atomic<std::uint32_t> next;
+	std::atomic<std::uint32_t> serving;
+};
+
+struct TicketLocker
+{
+	explicit TicketLocker(TicketLock* lock) :
+		m_lock(lock)
+	{
+		if (lock == nullptr)
+			throw std::runtime_error("TicketLock cannot be nullptr");
+	}
+
+	void lock()
+	{
+		const std::uint32_t ticket = m_lock->next.fetch_add(1, std::memory_order_relaxed);
+		SpinBackoff backoff;
+		while (m_lock->serving.load(std::memory_order_acquire) != ticket)
+			backoff.pause();
+	}
+
+	void unlock()
+	{
+		// only the holder writes 'serving'
+		m_lock->serving.store(m_lock->serving.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	void lock_shared()
+	{
+		lock();
+	}
+
+	void unlock_shared()
+	{
+		unlock();
+	}
+
+private:
+	TicketLock* m_lock = nullptr;
+};
+
+const int sMaxMCSNodes = 64;
+
+struct MCSNode
+{
+	// index + 1 of the waiter queued behind, 0 if none yet
+	alignas(64) std::atomic<std::uint32_t> next;
+	// 1 while waiting, cleared by the previous holder to hand the lock over
+	std::atomic<std::uint32_t> locked;
+};
+
+// Waiters queue up behind 'tail', each spinning on its own node until the one before hands the lock over.
+// Processes map the segment at different addresses, so nodes are in the lock itself and linked by index rather than
+// by pointer. Each locker holds a node for its lifetime, at most sMaxMCSNodes lockers at once. A process killed while
+// holding a node leaks it.
+struct MCSLock
+{
+	// index + 1 of the last node in the queue, 0 if lock is free
+	alignas(64) std::atomic<std::uint32_t> tail;
+	// bit per node held by a locker
+	std::atomic<std::uint64_t> used_nodes;
+	MCSNode nodes[sMaxMCSNodes];
+};
+
+static_assert(sMaxMCSNodes <= 64, "MCSLock::used_nodes has a bit per node");
+
+struct MCSLocker
+{
+	explicit MCSLocker(MCSLock* lock) :
+		m_lock(lock)
+	{
+		if (lock == nullptr)
+			throw std::runtime_error("MCSLock cannot be nullptr");
+
+		std::uint64_t used = m_lock->used_nodes.load(std::memory_order_relaxed);
+		do
+		{
+			if (~used == 0)
+				throw std::runtime_error("Error: MCSLock has no free node left");
+			m_node = std::countr_one(used);
+		}
+		while (!m_lock->used_nodes.compare_exchange_weak(used, used | (1ull << m_node), std::memory_order_acq_rel));
+	}
+
+	~MCSLocker()
+	{
+		m_lock->used_nodes.fetch_and(~(1ull << m_node), std::memory_order_acq_rel);
+	}
+
+	void lock()
+	{
+		MCSNode& node = m_lock->nodes[m_node];
+		node.next.store(0, std::memory_order_relaxed);
+		node.locked.store(1, std::memory_order_relaxed);
+
+		const std::uint32_t prev = m_lock->tail.exchange(m_node + 1, std::memory_order_acq_rel);
+		if (prev == 0)
+			return;
+
+		m_lock->nodes[prev - 1].next.store(m_node + 1, std::memory_order_release);
+		SpinBackoff backoff;
+		while (node.locked.load(std::memory_order_acquire) != 0)
+			backoff.pause();
+	}
+
+	void unlock()
+	{
+		MCSNode& node = m_lock->nodes[m_node];
+		std::uint32_t next = node.next.load(std::memory_order_acquire);
+		if (next == 0)
+		{
+			// nobody behind, unless one has just swapped itself into tail and is about to link
+			std::uint32_t self = m_node + 1;
+			if (m_lock->tail.compare_exchange_strong(self, 0, std::memory_order_acq_rel))
+				return;
+
+			SpinBackoff backoff;
+			while ((next = node.next.load(std::memory_order_acquire)) == 0)
+				backoff.pause();
+		}
+		m_lock->nodes[next - 1].locked.store(0, std::memory_order_release);
+	}
+
+	void lock_shared()
+	{
+		lock();
+	}
+
+	void unlock_shared()
+	{
+		unlock();
+	}
+
+private:
+	// disable copy-construct, and assignment operator
+	MCSLocker(const MCSLocker&);
+	MCSLocker& operator=(const MCSLocker&);
+
+	MCSLock* m_lock = nullptr;
+	std::uint32_t m_node = 0;
+};
+
+#if defined(USE_TICKET_LOCK)
+using RingLock = TicketLock;
+using RingLocker = TicketLocker;
+const char* const sRingLockName = "ticket";
+#elif defined(USE_MCS_LOCK)
+using RingLock = MCSLock;
+using RingLocker = MCSLocker;
+const char* const sRingLockName = "mcs";
+#else
+using RingLock = pthread_rwlock_t;
+using RingLocker = PthreadRWLocker;
+const char* const sRingLockName = "rwlock";
+#endif
+
+// Process-shared, by whoever creates the segment before anyone else uses it
+inline void initRingLock(RingLock* lock)
+{
+#if defined(USE_TICKET_LOCK) || defined(USE_MCS_LOCK)
+	new (lock) RingLock();
+#else
+	pthread_rwlockattr_t attr;
+	pthread_rwlockattr_init(&attr);
+	pthread_rwlockattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+	pthread_rwlock_init(lock, &attr);
+	pthread_rwlockattr_destroy(&attr);
+#endif
+}
+
+inline void destroyRingLock(RingLock* lock)
+{
+#if !defined(USE_TICKET_LOCK) && !defined(USE_MCS_LOCK)
+	pthread_rwlock_destroy(lock);
+#endif
+}
+
+};
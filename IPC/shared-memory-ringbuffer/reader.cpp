@@ -1,5 +1,6 @@
 /**
- * Consumer process will continue reading data as assigned from the writer process with delay in each iteraion of reading.
+ * Consumer process will continue reading data as assigned from the writer process, sleeping until writer has put
+ * something rather than polling.
  * It will automatically break out from the loop if the writer process has terminated via checking 'operational' flag.
  *
  * Notice that there is no logic to avoid reading the old data as written into shared memory.
@@ -11,16 +12,11 @@
 #include <unistd.h>
 #include <pthread.h>
 #include <csignal>
-#include <random>
-#include <thread>
 #include <chrono>
 
-#ifdef BENCH_LATENCY
-#include <fstream>
-#endif
-
 #include "lib.h"
 #include "ringbuffer.h"
+#include "../shared-memory-ringbuffer-atomic/histogram.h"
 
 using namespace lib;
 
@@ -29,7 +25,7 @@ MMap* s_mmap = nullptr;
 SharedData *s_ptr = nullptr;
 
 #ifdef BENCH_LATENCY
-std::ofstream *s_ts_output_file = nullptr;
+LatencyHistogram* s_histogram = nullptr;
 #endif
 
 // shared memory won't be unlinked automatically and it still exists on the machine if signal comes
@@ -37,10 +33,9 @@ std::ofstream *s_ts_output_file = nullptr;
 void signal_handler(int signal)
 {
 #ifdef BENCH_LATENCY
-	// close the file if not yet
-	// this happens when signal caught after opening the file and we are not done yet
-	if (s_ts_output_file != nullptr && s_ts_output_file->is_open())
-		s_ts_output_file->close();
+	// usual way to stop the bench, so report what we have got so far
+	if (s_histogram != nullptr)
+		s_histogram->print(std::cout);
 #endif
 
 	// just make a copy
@@ -59,11 +54,6 @@ int main(int argc, char* argv[])
 	std::signal(SIGINT, signal_handler);
 	std::signal(SIGTERM, signal_handler);
 
-	// random for ms to delay each iteration of writing into shared memory
-	std::random_device rd;
-	std::mt19937 gen(rd());
-	std::uniform_int_distribution<> dis(50, 120);
-
 	// recommended to use slash prefixed from manpage
 	const char* name = "/osimhen";
 	const int SIZE = sizeof(SharedData);
@@ -92,67 +82,57 @@ int main(int argc, char* argv[])
 	MMap mmap(ptr, SIZE);
 	s_mmap = &mmap;
 
-	RingBuffer rb(ptr->elems, sElementSize, &ptr->rb_ctrl_fields.rwlock, &ptr->rb_ctrl_fields.head, &ptr->rb_ctrl_fields.tail);
+	RingBuffer rb(ptr->elems, sElementSize, &ptr->rb_ctrl_fields);
 
 	bool operational = true;
-	ElementData data;	// reuse holding data structure
 
 #ifdef BENCH_LATENCY
-	const char* ts_output_filename = "ts-input.txt";
-	if (argc > 1)
-		ts_output_filename = argv[1];
-
-	// ignore the current file content, open for writing and truncate them
-	std::ofstream ts_output_file(ts_output_filename, std::ios::out | std::ios::trunc);
-	if (!ts_output_file.is_open())
-	{
-		std::cerr << "Error opening file for output benchmark of cache latency access\n";
-		return 1;
-	}
+	ElementData data;	// reuse holding data structure
 
-	s_ts_output_file = &ts_output_file;
+	// aggregated in memory and reported at exit, nothing is written per message
+	LatencyHistogram histogram;
+	s_histogram = &histogram;
 
-	// turn off buffering of file
-	ts_output_file.rdbuf()->pubsetbuf(nullptr, 0);
-	// output header column names
-	ts_output_file << "Timestamp,Latency\n" << std::flush;
+	// whatever writer published before reader started has been waiting for it, not travelling
+	while (rb.get(data))
+		;
 #endif
 
 	while (operational)
 	{
 #ifdef BENCH_LATENCY
-		auto start = std::chrono::steady_clock::now();
-		bool res = rb.get(data);
-		auto end = std::chrono::steady_clock::now();
-		std::chrono::duration<double, std::micro> elapsed = end - start;
-		double elapsed_value = elapsed.count();
-
-		if (res)
+		// drain everything there is, so what's measured is travel time rather than time queued behind this loop
+		while (rb.get(data))
 		{
-			std::cout << data << std::endl;
-
-			// current milli
-			auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(end.time_since_epoch()).count();
-			// output to the file for time series
-			ts_output_file << ms << "," << elapsed_value << "\n" << std::flush;
+			// one-way latency, from writer publishing it to here
+			histogram.record(steadyNowNs() - data.sent_ns);
 		}
-		else
-			std::cerr << "not available data\n";
 #else
-		if (rb.get(data))
-			std::cout << data << std::endl;
-		else
-			std::cerr << "not available data\n";
+		// block until writer puts something, but wake up once in a while to check whether writer is still operational
+		if (rb.waitNotEmpty(std::chrono::milliseconds(100)))
+		{
+			// inspect the element in place, then hand the slot back
+			if (const ElementData* elem = rb.peek())
+			{
+				std::cout << *elem << std::endl;
+				rb.release(1);
+			}
+		}
 #endif
 
 		RWUniqueLock _opt_lock(&ptr->rwlock);
 		operational = ptr->operational;
 		_opt_lock.unlock();
 
-		// random delay time in ms
-		int delay_ms = dis(gen);
-		std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
+#ifdef BENCH_LATENCY
+		// a sleep would be measured as latency of whatever arrives meanwhile
+		sched_yield();
+#endif
 	}
 
+#ifdef BENCH_LATENCY
+	histogram.print(std::cout);
+#endif
+
 	return 0;
 }
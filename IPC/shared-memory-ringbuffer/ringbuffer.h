@@ -3,43 +3,82 @@
 #include <pthread.h>
 #include <cassert>
 #include <sched.h>
+#include <ctime>
+#include <chrono>
+#include <span>
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
 
 #include "lib.h"
 
 using namespace lib;
 
+// Up to two runs of contiguous slots, 'second' is only non-empty when the run wraps around the end of buffer
+template <typename T>
+struct SlotSpans
+{
+	std::span<T> first;
+	std::span<T> second;
+
+	std::size_t size() const
+	{
+		return first.size() + second.size();
+	}
+
+	bool empty() const
+	{
+		return first.empty();
+	}
+};
+
 // Ring buffer operating through pointer
+//
+// head and tail are free-running 64-bit positions which never wrap, the slot of a position is derived from it. So
+// full and empty are told apart without leaving a slot unused, and size() is a single subtraction.
 class RingBuffer
 {
 public:
 	// accept the pointer to the shared data to mgmt fields
-    RingBuffer(ElementData* buffer_ptr, int buffer_size, pthread_rwlock_t* rwlock_ptr, int* head_ptr, int* tail_ptr) :
+    RingBuffer(ElementData* buffer_ptr, int buffer_size, RingLock* lock_ptr, std::uint64_t* head_ptr, std::uint64_t* tail_ptr) :
         m_buffer(buffer_ptr),
 		m_buffer_size(buffer_size),
         m_head(head_ptr),
         m_tail(tail_ptr),
-		m_rwLock(rwlock_ptr)
+		m_locker(lock_ptr)
     {
 		assert(m_buffer != nullptr);
 		assert(m_buffer_size > 0);
-		assert(m_rwLock != nullptr);
 		assert(m_head != nullptr);
 		assert(m_tail != nullptr);
     }
 
+	// With the wait fields, put() wakes up a consumer sleeping in waitNotEmpty()
+	RingBuffer(ElementData* buffer_ptr, int buffer_size, RingBufferCtrlFields* ctrl_ptr) :
+		RingBuffer(buffer_ptr, buffer_size, &ctrl_ptr->lock, &ctrl_ptr->head, &ctrl_ptr->tail)
+	{
+		m_wait_mutex = &ctrl_ptr->wait_mutex;
+		m_not_empty = &ctrl_ptr->not_empty;
+	}
+
     bool isFull()
     {
-		RWSharedLock _shared_lock(m_rwLock);
+		std::shared_lock _shared_lock(m_locker);
         return _isFull_nolock();
     }
 
 private:
     bool _isFull_nolock()
     {
-        const size_t s = m_buffer_size;
-        return ((s + *m_head - *m_tail) % s) + 1 >= s;  
+        return *m_head - *m_tail >= static_cast<std::uint64_t>(m_buffer_size);
     }
 
+	ElementData& _slot(std::uint64_t pos)
+	{
+		return m_buffer[pos % m_buffer_size];
+	}
+
 	// disable copy-construct, and assignment operator
 	RingBuffer(const RingBuffer&);
 	RingBuffer(RingBuffer&&);
@@ -49,8 +88,8 @@ private:
 public:
     bool isEmpty()
     {
-		RWSharedLock _shared_lock(m_rwLock);
-        return !_isFull_nolock() && (*m_head == *m_tail);
+		std::shared_lock _shared_lock(m_locker);
+        return *m_head == *m_tail;
     }
 
     void put(const ElementData& obj)
@@ -64,13 +103,42 @@ public:
 			// there might be better option to do this
 		}
 
-		RWLock _lock(m_rwLock);
-        m_buffer[*m_head] = obj;
-        *m_head = (*m_head + 1) % m_buffer_size;
+		{
+			std::lock_guard _lock(m_locker);
+			_slot(*m_head) = obj;
+			++*m_head;
+		}
 
-		std::cout << "Head: " << *m_head << ", Tail: " << *m_tail << std::endl;
+		// consumer checks for emptiness under wait_mutex, so it either sees the element or gets this signal
+		if (m_not_empty != nullptr)
+		{
+			pthread_mutex_lock(m_wait_mutex);
+			pthread_cond_signal(m_not_empty);
+			pthread_mutex_unlock(m_wait_mutex);
+		}
     }
 
+	// Sleep until there is something to get, or 'timeout' has passed. Return whether ring is non-empty.
+	// Only for a ring made with RingBufferCtrlFields.
+	bool waitNotEmpty(std::chrono::nanoseconds timeout)
+	{
+		assert(m_not_empty != nullptr);
+
+		timespec deadline;
+		clock_gettime(CLOCK_MONOTONIC, &deadline);
+		const std::uint64_t deadline_ns = deadline.tv_nsec + static_cast<std::uint64_t>(timeout.count());
+		deadline.tv_sec += deadline_ns / 1'000'000'000;
+		deadline.tv_nsec = deadline_ns % 1'000'000'000;
+
+		pthread_mutex_lock(m_wait_mutex);
+		bool ready = !isEmpty();
+		while (!ready && pthread_cond_timedwait(m_not_empty, m_wait_mutex, &deadline) == 0)
+			ready = !isEmpty();
+		pthread_mutex_unlock(m_wait_mutex);
+
+		return ready || !isEmpty();
+	}
+
 	bool get(ElementData& rdata)
 	{
 		return getImpl(rdata);
@@ -78,7 +146,7 @@ public:
 
     void reset()
     {
-		RWLock _lock(m_rwLock);
+		std::lock_guard _lock(m_locker);
         *m_head = 0;
         *m_tail = 0;
         // TODO: shall we reset value of all element as well ?
@@ -86,33 +154,15 @@ public:
 
     size_t size()
     {
-        if (isFull())
-			return m_buffer_size;
-        else
-        {
-            // head can be at index less than tail
-			RWSharedLock _lock(m_rwLock);
-            return (m_buffer_size + *m_head - *m_tail) % m_buffer_size;
-        }
+		std::shared_lock _lock(m_locker);
+        return *m_head - *m_tail;
     }
 
     void printAllElements()
     {
-        // isEmpty() already locked
-        if (!isEmpty())
-        {
-            std::size_t optSize = size();
-
-			RWUniqueLock _lock(m_rwLock, std::defer_lock);
-			_lock.lock();
-            int tailCopy = *m_tail;
-            for (std::size_t i=0; i<optSize-1; i++)
-            {
-                std::cout << m_buffer[tailCopy] << "\n";
-                tailCopy = (tailCopy + 1) % m_buffer_size;
-            }
-			_lock.unlock();
-        }
+		std::shared_lock _lock(m_locker);
+        for (std::uint64_t pos=*m_tail; pos!=*m_head; ++pos)
+            std::cout << _slot(pos) << "\n";
     }
 
 private:
@@ -123,19 +173,58 @@ private:
 		if (isEmpty())
 			return false;
 
-		RWLock _lock(m_rwLock);
-		rdata = m_buffer[*m_tail];
-		*m_tail = (*m_tail + 1) % m_buffer_size;
+		std::lock_guard _lock(m_locker);
+		rdata = _slot(*m_tail);
+		++*m_tail;
 
 		return true;
 	}
 
-	// possibly need to implement return by batch
+public:
+	// Return the next element in place without copying it out, nullptr if there is none.
+	// The slot stays untouched by producer until release(), so it's read without holding the lock.
+	// Meant for a single consumer, as another one would see the same element until release().
+	const ElementData* peek()
+	{
+		std::shared_lock _lock(m_locker);
+		if (*m_head == *m_tail)
+			return nullptr;
+
+		return &_slot(*m_tail);
+	}
+
+	// Return up to 'n' available elements in place as up to two spans (empty if there is none).
+	// They stay untouched by producer until release().
+	SlotSpans<const ElementData> peek(std::size_t n)
+	{
+		std::shared_lock _lock(m_locker);
+		const std::size_t available = *m_head - *m_tail;
+		n = std::min(available, n);
+
+		const std::size_t idx = *m_tail % m_buffer_size;
+		const std::size_t first = std::min(n, m_buffer_size - idx);
+		return { std::span<const ElementData>(m_buffer + idx, first), std::span<const ElementData>(m_buffer, n - first) };
+	}
+
+	// Hand the first 'n' peeked slots back to producer, taking the lock once for all of them.
+	// 'n' must not be more than what the last peek() returned.
+	void release(std::size_t n)
+	{
+		if (n == 0)
+			return;
+
+		std::lock_guard _lock(m_locker);
+		*m_tail += n;
+	}
 
 private:
     ElementData* m_buffer = nullptr;
 	const int m_buffer_size = 0;
-    int* m_head = nullptr;
-    int* m_tail = nullptr;
-    pthread_rwlock_t* m_rwLock = nullptr;
+    std::uint64_t* m_head = nullptr;
+    std::uint64_t* m_tail = nullptr;
+	// this side's handle to the lock in RingBufferCtrlFields
+	RingLocker m_locker;
+	// nullptr unless made with RingBufferCtrlFields
+	pthread_mutex_t* m_wait_mutex = nullptr;
+	pthread_cond_t* m_not_empty = nullptr;
 };
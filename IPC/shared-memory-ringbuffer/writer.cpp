@@ -35,10 +35,10 @@ void signal_handler(int signal)
 
 	if (s_ptr != nullptr)
 	{
-		// destroy RingBuffer's rwlock
+		// destroy RingBuffer's lock
 		{
 			// due to RAII, we dont need to worry about unlocking
-			pthread_rwlock_destroy(&s_ptr->rb_ctrl_fields.rwlock);
+			destroyRingLock(&s_ptr->rb_ctrl_fields.lock);
 		}
 
 		// destroy SharedData's rwlock
@@ -49,6 +49,12 @@ void signal_handler(int signal)
 			_lock.unlock();
 			pthread_rwlock_destroy(&s_ptr->rwlock);
 		}
+
+		// wake up reader to find 'operational' cleared. Wait fields aren't destroyed as reader may still be
+		// sleeping on them, they go away with the segment.
+		pthread_mutex_lock(&s_ptr->rb_ctrl_fields.wait_mutex);
+		pthread_cond_broadcast(&s_ptr->rb_ctrl_fields.not_empty);
+		pthread_mutex_unlock(&s_ptr->rb_ctrl_fields.wait_mutex);
 	}
 
 	// just make a copy
@@ -111,15 +117,11 @@ int main()
 		pthread_rwlock_init(&ptr->rwlock, &attr);
 	}
 
-	// initialize rwlock for RingBuffer's control fields
-	{
-		pthread_rwlockattr_t attr;
-		pthread_rwlockattr_init(&attr);
-		pthread_rwlockattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
-		pthread_rwlock_init(&ptr->rb_ctrl_fields.rwlock, &attr);
-	}
+	// initialize lock for RingBuffer's control fields
+	initRingLock(&ptr->rb_ctrl_fields.lock);
+	initRingWait(&ptr->rb_ctrl_fields);
 
-	RingBuffer rb(ptr->elems, sElementSize, &ptr->rb_ctrl_fields.rwlock, &ptr->rb_ctrl_fields.head, &ptr->rb_ctrl_fields.tail);
+	RingBuffer rb(ptr->elems, sElementSize, &ptr->rb_ctrl_fields);
 
 	int increment_id = 0;
 	while (s_still_operate)
@@ -138,9 +140,8 @@ int main()
 		if (!s_still_operate)
 			break;
 
+		elem_data.sent_ns = steadyNowNs();
 		rb.put(elem_data);
-		rb.printAllElements();
-		std::cout << "---------" << std::endl;
 
 		if (!ptr->operational)
 			ptr->operational = true;